@@ -0,0 +1,344 @@
+#include <iostream>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <new>
+#include <cstdio>
+#include <cstdlib>
+#include <cstdint>
+#include <cstddef>
+
+#ifdef __linux__
+#include <cstring>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+#include "bench.h"
+#include "../soa_object_manager.h"
+#include "../soa_simd.h"
+
+/*
+ * Benchmark of the CES implementations, all of them in one binary.
+ *
+ * usage: ces_bench [max entities]
+ *
+ * For 1e3, 1e4, ... entities (up to 1e7 by default) each engine creates the
+ * entities, iterates the positions, looks them up in random order, joins positions
+ * with names, dispatches events and destroys everything again.
+ * Reported per operation: nanoseconds, last level cache misses (when the kernel lets
+ * us count them), and for create the heap bytes each entity took.
+ *
+ * After the engines, the movement kernels of soa_simd.h integrate and transform as
+ * many bodies at each level the CPU supports.
+ */
+
+namespace
+{
+  //every heap allocation goes through here, so the engines' memory use can be measured
+  std::atomic< std::size_t > live_bytes( 0 );
+
+  const std::size_t header_size = 16; //keeps the returned memory 16 byte aligned
+
+  void* allocate( std::size_t size )
+  {
+    void* p = std::malloc( size + header_size );
+    if( !p )
+    {
+      throw std::bad_alloc();
+    }
+
+    *static_cast< std::size_t* >( p ) = size;
+    live_bytes += size;
+    return static_cast< char* >( p ) + header_size;
+  }
+
+  void deallocate( void* p )
+  {
+    if( p )
+    {
+      void* block = static_cast< char* >( p ) - header_size;
+      live_bytes -= *static_cast< std::size_t* >( block );
+      std::free( block );
+    }
+  }
+
+  //counts last level cache misses of the calling thread, if perf events are available
+  class cache_counter
+  {
+    int fd;
+  public:
+    bool valid()
+    {
+      return fd >= 0;
+    }
+
+    void start()
+    {
+#ifdef __linux__
+      if( valid() )
+      {
+        ioctl( fd, PERF_EVENT_IOC_RESET, 0 );
+        ioctl( fd, PERF_EVENT_IOC_ENABLE, 0 );
+      }
+#endif
+    }
+
+    long long stop()
+    {
+      long long count = 0;
+#ifdef __linux__
+      if( valid() )
+      {
+        ioctl( fd, PERF_EVENT_IOC_DISABLE, 0 );
+        if( read( fd, &count, sizeof( count ) ) != sizeof( count ) )
+        {
+          count = 0;
+        }
+      }
+#endif
+      return count;
+    }
+
+    cache_counter() : fd( -1 )
+    {
+#ifdef __linux__
+      perf_event_attr attr;
+      std::memset( &attr, 0, sizeof( attr ) );
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof( attr );
+      attr.config = PERF_COUNT_HW_CACHE_MISSES;
+      attr.disabled = 1;
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      fd = static_cast< int >( syscall( __NR_perf_event_open, &attr, 0, -1, -1, 0 ) );
+#endif
+    }
+
+    ~cache_counter()
+    {
+#ifdef __linux__
+      if( valid() )
+      {
+        close( fd );
+      }
+#endif
+    }
+  };
+
+  struct result
+  {
+    double ns; //per operation
+    double misses; //per operation, negative if unknown
+  };
+
+  cache_counter& counter()
+  {
+    static cache_counter instance;
+    return instance;
+  }
+
+  //runs func until at least min_time passed, func does ops operations per call
+  template< class f >
+  result measure( std::size_t ops, f func, std::chrono::milliseconds min_time = std::chrono::milliseconds( 0 ) )
+  {
+    typedef std::chrono::steady_clock clock;
+
+    std::size_t reps = 0;
+    clock::duration elapsed( 0 );
+    counter().start();
+    do
+    {
+      clock::time_point begin = clock::now();
+      func();
+      elapsed += clock::now() - begin;
+      ++reps;
+    }
+    while( elapsed < min_time );
+    long long misses = counter().stop();
+
+    result r;
+    r.ns = std::chrono::duration< double, std::nano >( elapsed ).count() / double( ops * reps );
+    r.misses = counter().valid() ? double( misses ) / double( ops * reps ) : -1.0;
+    return r;
+  }
+
+  void report( std::size_t count, const char* name, const char* op, const result& r, double bytes = -1.0 )
+  {
+    std::printf( "%10zu  %-8s %-10s %12.2f", count, name, op, r.ns );
+
+    if( r.misses >= 0.0 )
+    {
+      std::printf( " %12.3f", r.misses );
+    }
+    else
+    {
+      std::printf( " %12s", "-" );
+    }
+
+    if( bytes >= 0.0 )
+    {
+      std::printf( " %12.1f", bytes );
+    }
+
+    std::printf( "\n" );
+    std::fflush( stdout );
+  }
+
+  //xorshift, the same shuffle for every engine
+  void shuffle( std::vector< om::id_type >& v )
+  {
+    std::uint64_t s = 88172645463325252ull;
+    for( std::size_t c = v.size(); c > 1; --c )
+    {
+      s ^= s << 13;
+      s ^= s >> 7;
+      s ^= s << 17;
+      std::swap( v[c - 1], v[s % c] );
+    }
+  }
+
+  volatile double sink; //results go here, so the work isn't optimized away
+
+  //what the movement kernels work on
+  struct body
+  {
+    float x, y, z;
+    float vx, vy, vz;
+  };
+}
+
+OM_SOA_LAYOUT( body, &body::x, &body::y, &body::z, &body::vx, &body::vy, &body::vz )
+
+void* operator new( std::size_t size )
+{
+  return allocate( size );
+}
+
+void* operator new[]( std::size_t size )
+{
+  return allocate( size );
+}
+
+void* operator new( std::size_t size, const std::nothrow_t& ) throw()
+{
+  try
+  {
+    return allocate( size );
+  }
+  catch( ... )
+  {
+    return 0;
+  }
+}
+
+void* operator new[]( std::size_t size, const std::nothrow_t& ) throw()
+{
+  try
+  {
+    return allocate( size );
+  }
+  catch( ... )
+  {
+    return 0;
+  }
+}
+
+void operator delete( void* p ) throw()
+{
+  deallocate( p );
+}
+
+void operator delete[]( void* p ) throw()
+{
+  deallocate( p );
+}
+
+void operator delete( void* p, const std::nothrow_t& ) throw()
+{
+  deallocate( p );
+}
+
+void operator delete[]( void* p, const std::nothrow_t& ) throw()
+{
+  deallocate( p );
+}
+
+int main( int argc, char** argv )
+{
+  std::size_t max_count = argc > 1 ? std::strtoull( argv[1], 0, 10 ) : 10000000;
+  const std::size_t max_lookups = 1000000; //random lookups and events per run
+  const std::chrono::milliseconds min_time( 50 ); //repeated operations run at least this long
+
+  if( !counter().valid() )
+  {
+    std::printf( "cache miss counters are not available here\n" );
+  }
+
+  std::printf( "%10s  %-8s %-10s %12s %12s %12s\n", "entities", "engine", "operation", "ns/op", "misses/op", "bytes/entity" );
+
+  for( std::size_t count = 1000; count <= max_count; count *= 10 )
+  {
+    for( auto e = bench::engines().begin(); e != bench::engines().end(); ++e )
+    {
+      std::vector< om::id_type > ids( count );
+      std::vector< om::id_type > order;
+      order.reserve( count );
+
+      std::size_t before = live_bytes;
+      result r = measure( count, [&]{ ( *e )->create( ids.data(), count ); } );
+      report( count, ( *e )->name(), "create", r, double( live_bytes - before ) / double( count ) );
+
+      r = measure( count, [&]{ sink = ( *e )->iterate(); }, min_time );
+      report( count, ( *e )->name(), "iterate", r );
+
+      order = ids;
+      shuffle( order );
+      std::size_t lookups = count < max_lookups ? count : max_lookups;
+      r = measure( lookups, [&]{ sink = ( *e )->lookup( order.data(), lookups ); }, min_time );
+      report( count, ( *e )->name(), "lookup", r );
+
+      r = measure( count, [&]{ sink = double( ( *e )->join() ); }, min_time );
+      report( count, ( *e )->name(), "join", r );
+
+      if( ( *e )->dispatch( 1 ) )
+      {
+        r = measure( lookups, [&]{ sink = double( ( *e )->dispatch( lookups ) ); }, min_time );
+        report( count, ( *e )->name(), "dispatch", r );
+      }
+
+      r = measure( count, [&]{ ( *e )->destroy( ids.data(), count ); } );
+      report( count, ( *e )->name(), "destroy", r );
+    }
+
+    om::soa_object_manager< body > bodies;
+    for( std::size_t c = 0; c < count; ++c )
+    {
+      body b = { float( c ), 0.0f, 0.0f, 1.0f, 0.5f, 0.25f };
+      bodies.add( b );
+    }
+
+    const float m[12] = { 1, 0, 0, 0.5f, 0, 1, 0, 0.25f, 0, 0, 1, 0.125f };
+    om::simd::float3_columns p = om::simd::columns< 0, 1, 2 >( bodies );
+    om::simd::float3_columns v = om::simd::columns< 3, 4, 5 >( bodies );
+    om::simd::level best = om::simd::detect();
+
+    for( int l = om::simd::scalar; l <= best; ++l )
+    {
+      om::simd::set_level( om::simd::level( l ) );
+      const char* name = om::simd::level_name( om::simd::level( l ) );
+
+      result r = measure( count, [&]{ om::simd::integrate( p, v, 0.016f, count ); }, min_time );
+      report( count, name, "integrate", r );
+
+      r = measure( count, [&]{ om::simd::transform( p, m, count ); }, min_time );
+      report( count, name, "transform", r );
+    }
+    om::simd::set_level( best );
+    sink = bodies.column< 0 >()[0];
+  }
+
+  return 0;
+}
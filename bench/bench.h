@@ -0,0 +1,61 @@
+#ifndef bench_h
+#define bench_h
+
+#include <vector>
+#include <cstddef>
+
+#include "../object_manager.h"
+
+namespace bench
+{
+  /*
+   * What a CES implementation has to do for the benchmark. Each type_*.cpp implements
+   * this when built with CES_BENCHMARK, instead of its demo main().
+   *
+   * Every entity gets a position, every second one a name as well. The ids array is
+   * owned by the benchmark, so it doesn't count toward the engine's memory.
+   */
+  class engine
+  {
+  public:
+    virtual const char* name() = 0;
+
+    virtual void create( om::id_type* ids, std::size_t count ) = 0;
+    virtual void destroy( const om::id_type* ids, std::size_t count ) = 0;
+
+    //visits every position, returns the sum of x so the work can't be optimized away
+    virtual double iterate() = 0;
+
+    //finds the position of each entity, in the given order
+    virtual double lookup( const om::id_type* ids, std::size_t count ) = 0;
+
+    //visits every entity that has both a position and a name, returns how many did
+    virtual std::size_t join() = 0;
+
+    //raises count events and dispatches them, returns how many were handled
+    //engines without events return 0
+    virtual std::size_t dispatch( std::size_t )
+    {
+      return 0;
+    }
+
+    virtual ~engine() {}
+  };
+
+  inline std::vector< engine* >& engines()
+  {
+    static std::vector< engine* > instance;
+    return instance;
+  }
+
+  //a static one of these in each engine's file adds the engine to the benchmark
+  struct registrar
+  {
+    registrar( engine* e )
+    {
+      engines().push_back( e );
+    }
+  };
+}
+
+#endif
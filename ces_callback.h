@@ -1,143 +1,316 @@
-#ifndef ces_callback_h
-#define ces_callback_h
-
-#include <vector>
-#include <list>
-
-namespace ces
-{
-  //60 bytes
-  union callback_data
-  {
-    struct
-    {
-      char data[60];
-    };
-
-    struct
-    {
-      char core[32];
-      char aux[28];
-    };
-
-    struct
-    {
-      unsigned v4[15];
-    };
-
-    struct
-    {
-      unsigned long long v8[7];
-      unsigned dummy;
-    };
-  };
-
-  //64 bytes
-  struct callback_pack
-  {
-    unsigned type;
-    callback_data cbd;
-  };
-
-  class callback_base
-  {
-  public:
-    virtual bool operator()( const callback_pack& cbd ){ return false; }
-    virtual callback_base* clone()
-    {
-      return 0;
-    }
-  };
-
-  template< class t >
-  class callback : public callback_base
-  {
-    t func;
-  public:
-    bool operator()( const callback_pack& cbd )
-    {
-      return func( cbd );
-    }
-
-    callback* clone()
-    {
-      return new callback( *this );
-    }
-
-    callback( t f ) : func( f ) {}
-  };
-
-  class callback_manager
-  {
-  private:
-    std::list< callback_base* > callbacks;
-    std::vector< callback_pack > events;
-  protected:
-    callback_manager(){}; //singleton
-    callback_manager(const callback_manager&);
-    callback_manager(callback_manager&&);
-    callback_manager& operator=(const callback_manager&);
-  public:
-    template< class t >
-    void add_callback( t cb )
-    {
-      callbacks.push_back( new callback< t >( cb ) );
-    }
-
-    void add_event( const callback_pack& cbp )
-    {
-      events.push_back( cbp );
-    }
-
-    void dispatch_callbacks()
-    {
-      auto cnt = 0;
-      for( auto c = events.begin(); c != events.end(); ++cnt )
-      {
-        bool found = false;
-        for( auto d = callbacks.begin(); d != callbacks.end(); ++d )
-        {
-          if( (**d)( *c ) ) //event handled
-          {
-            events.erase( c );
-
-            if( events.size() > 0 )
-            {
-              c = events.begin();
-              for( int i = 0; i < cnt; ++i );
-            }
-            else
-            {
-              c = events.begin();
-            }
-
-            found = true;
-
-            break;
-          }
-        }
-
-        if( !found )
-        {
-          ++c;
-        }
-      }
-    }
-
-    ~callback_manager()
-    {
-      for( auto c = callbacks.begin(); c != callbacks.end(); ++c )
-      {
-        delete *c;
-      }
-    }
-
-    static callback_manager& callback_manager::get()
-    {
-      static callback_manager instance;
-      return instance;
-    }
-  };
-}
-
+#ifndef ces_callback_h
+#define ces_callback_h
+
+#include <vector>
+#include <new>
+#include <utility>
+#include <cstring>
+#include <cstddef>
+#include <type_traits>
+
+#include "ces_profiler.h"
+#include "ces_thread_pool.h"
+
+namespace ces
+{
+  //60 bytes
+  union callback_data
+  {
+    struct
+    {
+      char data[60];
+    };
+
+    struct
+    {
+      char core[32];
+      char aux[28];
+    };
+
+    struct
+    {
+      unsigned v4[15];
+    };
+
+    struct
+    {
+      unsigned long long v8[7];
+      unsigned dummy;
+    };
+  };
+
+  //64 bytes
+  struct callback_pack
+  {
+    unsigned type;
+    callback_data cbd;
+  };
+
+  /*
+   * Type erased callback with inline storage for its captures, so making one never
+   * allocates. Calls go through a plain function pointer instead of a vtable, and
+   * delegates are stored by value, so a list of them is one contiguous block.
+   */
+  class delegate
+  {
+  public:
+    static const std::size_t storage_size = 48; //bytes of captures that fit inline
+  private:
+    enum operation
+    {
+      op_copy, op_move, op_destroy
+    };
+
+    typedef bool (*invoke_fn)( void* func, const callback_pack& cbp );
+    typedef void (*manage_fn)( void* dst, void* src, operation op );
+
+    typename std::aligned_storage< storage_size, sizeof( void* ) * 2 >::type storage;
+    invoke_fn invoke;
+    manage_fn manage; //0 for trivially copyable captures, those are just memcpy'd
+
+    template< class t >
+    static bool invoke_thunk( void* func, const callback_pack& cbp )
+    {
+      return ( *static_cast< t* >( func ) )( cbp );
+    }
+
+    template< class t >
+    static void manage_thunk( void* dst, void* src, operation op )
+    {
+      switch( op )
+      {
+      case op_copy:
+        new( dst ) t( *static_cast< const t* >( src ) );
+        break;
+      case op_move:
+        new( dst ) t( std::move( *static_cast< t* >( src ) ) );
+        break;
+      case op_destroy:
+        static_cast< t* >( dst )->~t();
+        break;
+      }
+    }
+
+    void assign( const delegate& o, operation op )
+    {
+      invoke = o.invoke;
+      manage = o.manage;
+
+      if( manage )
+      {
+        manage( &storage, const_cast< void* >( static_cast< const void* >( &o.storage ) ), op );
+      }
+      else
+      {
+        std::memcpy( &storage, &o.storage, storage_size );
+      }
+    }
+
+    void destroy()
+    {
+      if( manage )
+      {
+        manage( &storage, 0, op_destroy );
+      }
+    }
+  public:
+    bool operator()( const callback_pack& cbp )
+    {
+      return invoke( &storage, cbp );
+    }
+
+    template< class t, class = typename std::enable_if< !std::is_same< typename std::decay< t >::type, delegate >::value >::type >
+    delegate( t f ) : invoke( &invoke_thunk< t > ), manage( 0 )
+    {
+      static_assert( sizeof( t ) <= storage_size, "callback captures don't fit into a delegate" );
+      static_assert( std::alignment_of< t >::value <= sizeof( void* ) * 2, "callback captures are over-aligned" );
+
+      new( &storage ) t( std::move( f ) );
+
+      if( !std::is_trivially_copyable< t >::value )
+      {
+        manage = &manage_thunk< t >;
+      }
+    }
+
+    delegate( const delegate& o )
+    {
+      assign( o, op_copy );
+    }
+
+    delegate( delegate&& o )
+    {
+      assign( o, op_move );
+    }
+
+    delegate& operator=( const delegate& o )
+    {
+      if( this != &o )
+      {
+        destroy();
+        assign( o, op_copy );
+      }
+
+      return *this;
+    }
+
+    delegate& operator=( delegate&& o )
+    {
+      if( this != &o )
+      {
+        destroy();
+        assign( o, op_move );
+      }
+
+      return *this;
+    }
+
+    ~delegate()
+    {
+      destroy();
+    }
+  };
+
+  class callback_manager
+  {
+  private:
+    //events raised by one thread since the last dispatch
+    struct event_buffer
+    {
+      std::vector< callback_pack > events;
+    };
+
+    std::vector< std::vector< delegate > > routes; //callbacks subscribed to each event type
+    std::vector< delegate > callbacks; //callbacks that are offered every event type
+    std::vector< callback_pack > events; //the batch being dispatched
+    std::vector< callback_pack > unhandled; //events of the last dispatch nobody handled
+    thread_list< event_buffer > buffers; //one per thread that ever raised an event
+    bool dispatching;
+    std::vector< std::pair< unsigned, delegate > > pending_routes; //subscribed during a dispatch
+    std::vector< delegate > pending_callbacks;
+
+    //offers the event to the callbacks in order, until one handles it
+    static bool offer( std::vector< delegate >& subscribers, const callback_pack& cbp )
+    {
+      for( auto c = subscribers.begin(); c != subscribers.end(); ++c )
+      {
+        if( ( *c )( cbp ) )
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    //moves every thread's events into the batch
+    void merge_buffers()
+    {
+      buffers.each( [this]( event_buffer& b )
+      {
+        events.insert( events.end(), b.events.begin(), b.events.end() );
+        b.events.clear(); //keeps the capacity, so producers don't allocate next frame
+      } );
+    }
+
+    void add_route( unsigned type, const delegate& d )
+    {
+      if( type >= routes.size() )
+      {
+        routes.resize( type + 1 );
+      }
+
+      routes[type].push_back( d );
+    }
+
+    //adds what callbacks subscribed while the lists were being walked
+    void add_pending()
+    {
+      for( auto c = pending_routes.begin(); c != pending_routes.end(); ++c )
+      {
+        add_route( c->first, c->second );
+      }
+
+      callbacks.insert( callbacks.end(), pending_callbacks.begin(), pending_callbacks.end() );
+      pending_routes.clear();
+      pending_callbacks.clear();
+    }
+  protected:
+    callback_manager() : dispatching( false ) {}; //singleton
+    callback_manager(const callback_manager&);
+    callback_manager(callback_manager&&);
+    callback_manager& operator=(const callback_manager&);
+  public:
+    //subscribes to one event type
+    //callbacks added by a callback start getting events from the next dispatch
+    template< class t >
+    void add_callback( unsigned type, t cb )
+    {
+      if( dispatching )
+      {
+        pending_routes.push_back( std::make_pair( type, delegate( cb ) ) );
+      }
+      else
+      {
+        add_route( type, delegate( cb ) );
+      }
+    }
+
+    //offered every event that the subscribers of its type didn't handle
+    template< class t >
+    void add_callback( t cb )
+    {
+      if( dispatching )
+      {
+        pending_callbacks.push_back( delegate( cb ) );
+      }
+      else
+      {
+        callbacks.push_back( delegate( cb ) );
+      }
+    }
+
+    //can be called from any thread, never blocks
+    void add_event( const callback_pack& cbp )
+    {
+      buffers.local().events.push_back( cbp );
+    }
+
+    //must not run while other threads are still adding events
+    void dispatch_callbacks()
+    {
+      CES_PROFILE_SCOPE( "dispatch_callbacks" );
+      merge_buffers();
+      unhandled.clear();
+      dispatching = true;
+
+      for( auto c = events.begin(); c != events.end(); ++c )
+      {
+        bool found = c->type < routes.size() && offer( routes[c->type], *c );
+
+        if( !found && !offer( callbacks, *c ) )
+        {
+          unhandled.push_back( *c );
+        }
+      }
+
+      events.clear();
+      dispatching = false;
+      add_pending();
+    }
+
+    //events of the last dispatch that no callback handled
+    const std::vector< callback_pack >& get_unhandled()
+    {
+      return unhandled;
+    }
+
+    static callback_manager& get()
+    {
+      static callback_manager instance;
+      return instance;
+    }
+  };
+}
+
 #endif
\ No newline at end of file
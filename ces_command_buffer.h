@@ -0,0 +1,180 @@
+#ifndef ces_command_buffer_h
+#define ces_command_buffer_h
+
+#include <vector>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+#include "object_manager.h"
+#include "ces_profiler.h"
+#include "ces_thread_pool.h"
+
+namespace ces
+{
+  /*
+   * Records structural changes (creating and destroying entities, adding and removing
+   * components) while systems iterate, and applies them later in one batch, at a
+   * sync point where nobody iterates. Each thread records into its own buffer, so
+   * systems running in parallel can record without locking.
+   *
+   * world is the entity manager, it needs add_n( count, out ) and remove_n( ids, count ).
+   * Stores passed to remove() need remove_n( ids, count ).
+   *
+   * flush() applies, in this order:
+   *  -component removals, sorted and grouped by store, one remove_n per store
+   *  -entity destroys, sorted, one remove_n
+   *  -entity creates, one add_n, then each create's callback with the new id
+   *  -everything deferred with add(), in the order it was recorded
+   */
+  template< class world >
+  class command_buffer
+  {
+  public:
+    typedef std::function< void( om::id_type ) > create_func;
+    typedef std::function< void() > deferred_func;
+  private:
+    struct removal
+    {
+      void* store;
+      void (*remove_n)( void* store, const om::id_type* ids, std::size_t count );
+      om::id_type id;
+
+      bool operator<( const removal& o ) const
+      {
+        return store < o.store || ( store == o.store && id < o.id );
+      }
+
+      bool operator==( const removal& o ) const
+      {
+        return store == o.store && id == o.id;
+      }
+    };
+
+    struct buffer
+    {
+      std::vector< removal > removals;
+      std::vector< om::id_type > destroys;
+      std::vector< create_func > creates;
+      std::vector< deferred_func > adds;
+    };
+
+    thread_list< buffer > buffers; //one per thread that ever recorded a command
+    buffer batch; //everything merged, being applied
+
+    template< class store >
+    static void remove_thunk( void* s, const om::id_type* ids, std::size_t count )
+    {
+      static_cast< store* >( s )->remove_n( ids, count );
+    }
+
+    template< class t >
+    static void move_append( std::vector< t >& to, std::vector< t >& from )
+    {
+      to.insert( to.end(), std::make_move_iterator( from.begin() ), std::make_move_iterator( from.end() ) );
+      from.clear();
+    }
+  protected:
+    command_buffer() {} //singleton
+    command_buffer( const command_buffer& );
+    command_buffer( command_buffer&& );
+    command_buffer& operator=( const command_buffer& );
+  public:
+    //on_created is called with the new entity's id at flush time
+    void create( create_func on_created = create_func() )
+    {
+      buffers.local().creates.push_back( on_created );
+    }
+
+    void destroy( om::id_type entity_id )
+    {
+      buffers.local().destroys.push_back( entity_id );
+    }
+
+    //removes a component from a store
+    template< class store >
+    void remove( store& s, om::id_type id )
+    {
+      removal r;
+      r.store = &s;
+      r.remove_n = &remove_thunk< store >;
+      r.id = id;
+      buffers.local().removals.push_back( r );
+    }
+
+    //any other structural change, usually adding a component
+    void add( deferred_func func )
+    {
+      buffers.local().adds.push_back( func );
+    }
+
+    //must not run while other threads are still recording
+    void flush( world& w )
+    {
+      CES_PROFILE_SCOPE( "flush" );
+      buffers.each( [this]( buffer& b )
+      {
+        move_append( batch.removals, b.removals );
+        move_append( batch.destroys, b.destroys );
+        move_append( batch.creates, b.creates );
+        move_append( batch.adds, b.adds );
+      } );
+
+      //removing the same thing twice is recorded once
+      std::sort( batch.removals.begin(), batch.removals.end() );
+      batch.removals.erase( std::unique( batch.removals.begin(), batch.removals.end() ), batch.removals.end() );
+
+      std::vector< om::id_type > ids;
+      for( std::size_t c = 0; c < batch.removals.size(); )
+      {
+        std::size_t d = c;
+        ids.clear();
+        for( ; d < batch.removals.size() && batch.removals[d].store == batch.removals[c].store; ++d )
+        {
+          ids.push_back( batch.removals[d].id );
+        }
+
+        batch.removals[c].remove_n( batch.removals[c].store, ids.data(), ids.size() );
+        c = d;
+      }
+
+      std::sort( batch.destroys.begin(), batch.destroys.end() );
+      batch.destroys.erase( std::unique( batch.destroys.begin(), batch.destroys.end() ), batch.destroys.end() );
+      if( !batch.destroys.empty() )
+      {
+        w.remove_n( batch.destroys.data(), batch.destroys.size() );
+      }
+
+      if( !batch.creates.empty() )
+      {
+        ids.resize( batch.creates.size() );
+        w.add_n( ids.size(), ids.data() );
+        for( std::size_t c = 0; c < ids.size(); ++c )
+        {
+          if( batch.creates[c] )
+          {
+            batch.creates[c]( ids[c] );
+          }
+        }
+      }
+
+      for( auto c = batch.adds.begin(); c != batch.adds.end(); ++c )
+      {
+        ( *c )();
+      }
+
+      batch.removals.clear();
+      batch.destroys.clear();
+      batch.creates.clear();
+      batch.adds.clear();
+    }
+
+    static command_buffer& get()
+    {
+      static command_buffer instance;
+      return instance;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,153 @@
+#ifndef ces_parallel_h
+#define ces_parallel_h
+
+#include <atomic>
+#include <memory>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+#include "ces_thread_pool.h"
+
+namespace ces
+{
+  const std::size_t cache_line_size = 64;
+
+  /*
+   * One value per pool thread, each on its own cache lines, so threads can accumulate
+   * into local() without atomics or false sharing. combine() folds them afterwards.
+   */
+  template< class t >
+  class per_thread
+  {
+    static const std::size_t stride = ( sizeof( t ) + cache_line_size - 1 ) / cache_line_size * cache_line_size;
+
+    std::unique_ptr< unsigned char[] > buffer;
+    unsigned char* slots; //first cache line aligned slot
+    std::size_t count;
+
+    per_thread( const per_thread& );
+    per_thread& operator=( const per_thread& );
+  public:
+    t& local()
+    {
+      return ( *this )[thread_pool::current()];
+    }
+
+    t& operator[]( std::size_t i )
+    {
+      return *reinterpret_cast< t* >( slots + i * stride );
+    }
+
+    std::size_t size()
+    {
+      return count;
+    }
+
+    //folds all slots into init with op( a, b )
+    template< class f >
+    t combine( t init, f op )
+    {
+      for( std::size_t c = 0; c < count; ++c )
+      {
+        init = op( init, ( *this )[c] );
+      }
+
+      return init;
+    }
+
+    per_thread( const t& init = t() ) : count( thread_pool::get().size() )
+    {
+      buffer.reset( new unsigned char[count * stride + cache_line_size] );
+      std::uintptr_t p = reinterpret_cast< std::uintptr_t >( buffer.get() );
+      slots = buffer.get() + ( cache_line_size - p % cache_line_size ) % cache_line_size;
+
+      for( std::size_t c = 0; c < count; ++c )
+      {
+        new( slots + c * stride ) t( init );
+      }
+    }
+
+    ~per_thread()
+    {
+      for( std::size_t c = 0; c < count; ++c )
+      {
+        ( *this )[c].~t();
+      }
+    }
+  };
+
+  /*
+   * Calls func on every element of an object manager (or anything else with random
+   * access begin()/end()) from all pool threads. The range is cut into chunks of grain
+   * elements, rounded up to whole cache lines; 0 picks about 16 KB worth per chunk.
+   * The first chunk is stretched so that the others start on a cache line, when the
+   * element size allows it, so no two threads write the same line.
+   * Idle threads steal chunks, returns when every chunk is done.
+   * func must not add or remove elements of the store.
+   */
+  template< class store, class f >
+  void parallel_each( store& s, f func, std::size_t grain = 0 )
+  {
+    auto first = s.begin();
+    std::size_t n = s.end() - first;
+    const std::size_t elem = sizeof( *first );
+
+    if( n == 0 )
+    {
+      return;
+    }
+
+    if( grain == 0 )
+    {
+      grain = 16 * 1024 / elem;
+    }
+
+    //smallest element count that is a whole number of cache lines
+    std::size_t line = 1;
+    while( ( line * elem ) % cache_line_size != 0 && line < cache_line_size )
+    {
+      ++line;
+    }
+    grain = ( grain + line - 1 ) / line * line;
+
+    thread_pool& pool = thread_pool::get();
+    if( n <= grain || pool.size() == 1 )
+    {
+      for( std::size_t c = 0; c < n; ++c )
+      {
+        func( first[c] );
+      }
+      return;
+    }
+
+    //elements before the first cache line boundary, if one falls between two elements
+    std::size_t misalign = reinterpret_cast< std::uintptr_t >( &first[0] ) % cache_line_size;
+    std::size_t lead = 0;
+    if( misalign != 0 && ( cache_line_size - misalign ) % elem == 0 )
+    {
+      lead = ( cache_line_size - misalign ) / elem;
+    }
+
+    std::atomic< std::size_t > remaining( ( n - lead + grain - 1 ) / grain );
+
+    for( std::size_t begin = 0, end; begin < n; begin = end )
+    {
+      end = ( begin == 0 ? lead : begin ) + grain;
+      end = end < n ? end : n;
+      pool.submit( [&, begin, end]
+      {
+        for( std::size_t c = begin; c < end; ++c )
+        {
+          func( first[c] );
+        }
+
+        --remaining;
+      } );
+    }
+
+    pool.wait( remaining );
+  }
+}
+
+#endif
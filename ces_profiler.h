@@ -0,0 +1,231 @@
+#ifndef ces_profiler_h
+#define ces_profiler_h
+
+#include <vector>
+#include <string>
+#include <map>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <ostream>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "ces_thread_pool.h"
+
+namespace ces
+{
+  struct profile_sample
+  {
+    const char* name; //has to outlive the profiler, usually a string literal
+    std::uint64_t begin, end; //nanoseconds since the profiler started
+  };
+
+  //durations in microseconds
+  struct profile_stats
+  {
+    std::size_t count;
+    double min, avg, p99;
+  };
+
+  /*
+   * Records how long named scopes took, usually through CES_PROFILE_SCOPE.
+   *
+   * Every thread writes into its own ring buffer, the last ring_size samples are kept,
+   * so recording never locks or allocates (after the first sample of a thread).
+   * The stats and the trace are made from whatever is in the rings, so they are
+   * rolling over the recent frames. Read them at a sync point, when nothing records.
+   *
+   * Without CES_PROFILE defined the macro expands to nothing, so the instrumented
+   * code costs nothing.
+   */
+  class profiler
+  {
+  public:
+    static const std::size_t ring_size = 4096;
+  private:
+    struct ring
+    {
+      profile_sample samples[ring_size];
+      std::atomic< std::uint64_t > head; //samples ever written
+      unsigned thread; //numbered in the order the threads first recorded
+
+      static unsigned next_thread()
+      {
+        static std::atomic< unsigned > count( 0 );
+        return count++;
+      }
+
+      ring() : head( 0 ), thread( next_thread() ) {}
+    };
+
+    thread_list< ring > rings; //one per thread that ever recorded
+    std::chrono::steady_clock::time_point start;
+
+    static void write_string( std::ostream& o, const char* s )
+    {
+      o << '"';
+      for( ; *s; ++s )
+      {
+        if( *s == '"' || *s == '\\' )
+        {
+          o << '\\';
+        }
+        o << *s;
+      }
+      o << '"';
+    }
+  protected:
+    profiler() : start( std::chrono::steady_clock::now() ) {} //singleton
+    profiler( const profiler& );
+    profiler( profiler&& );
+    profiler& operator=( const profiler& );
+  public:
+    std::uint64_t now()
+    {
+      return std::chrono::duration_cast< std::chrono::nanoseconds >( std::chrono::steady_clock::now() - start ).count();
+    }
+
+    void record( const char* name, std::uint64_t begin, std::uint64_t end )
+    {
+      ring& r = rings.local();
+      std::uint64_t h = r.head.load( std::memory_order_relaxed );
+      profile_sample& s = r.samples[h % ring_size];
+      s.name = name;
+      s.begin = begin;
+      s.end = end;
+      r.head.store( h + 1, std::memory_order_release );
+    }
+
+    //calls func( thread, sample ) for every kept sample
+    template< class f >
+    void each_sample( f func )
+    {
+      rings.each( [&]( ring& r )
+      {
+        std::uint64_t h = r.head.load( std::memory_order_acquire );
+        for( std::uint64_t c = h > ring_size ? h - ring_size : 0; c < h; ++c )
+        {
+          func( r.thread, r.samples[c % ring_size] );
+        }
+      } );
+    }
+
+    //calls func( name, stats ) for each name that has samples
+    template< class f >
+    void each_stats( f func )
+    {
+      std::map< std::string, std::vector< double > > durations;
+      each_sample( [&]( unsigned, const profile_sample& s )
+      {
+        durations[s.name].push_back( double( s.end - s.begin ) / 1000.0 );
+      } );
+
+      for( auto c = durations.begin(); c != durations.end(); ++c )
+      {
+        std::vector< double >& d = c->second;
+
+        profile_stats st;
+        st.count = d.size();
+        st.min = *std::min_element( d.begin(), d.end() );
+        st.avg = 0;
+        for( auto e = d.begin(); e != d.end(); ++e )
+        {
+          st.avg += *e;
+        }
+        st.avg /= double( d.size() );
+
+        std::size_t rank = ( d.size() * 99 + 99 ) / 100 - 1; //nearest rank
+        std::nth_element( d.begin(), d.begin() + rank, d.end() );
+        st.p99 = d[rank];
+
+        func( c->first.c_str(), st );
+      }
+    }
+
+    //stats of one name, count is 0 if it has no samples
+    profile_stats get_stats( const char* name )
+    {
+      profile_stats result = { 0, 0, 0, 0 };
+      std::string n( name );
+      each_stats( [&]( const char* s, const profile_stats& st )
+      {
+        if( n == s )
+        {
+          result = st;
+        }
+      } );
+
+      return result;
+    }
+
+    //the kept samples in Chrome's trace event format, for chrome://tracing or Perfetto
+    void write_chrome_trace( std::ostream& o )
+    {
+      bool first = true;
+      o << "{\"traceEvents\":[";
+      each_sample( [&]( unsigned thread, const profile_sample& s )
+      {
+        o << ( first ? "\n" : ",\n" ) << "{\"name\":";
+        write_string( o, s.name );
+        o << ",\"ph\":\"X\",\"pid\":0,\"tid\":" << thread
+          << ",\"ts\":" << double( s.begin ) / 1000.0
+          << ",\"dur\":" << double( s.end - s.begin ) / 1000.0 << "}";
+        first = false;
+      } );
+      o << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    }
+
+    bool save_chrome_trace( const char* path )
+    {
+      std::ofstream f( path );
+      write_chrome_trace( f );
+      return f.good();
+    }
+
+    //forgets every sample
+    void clear()
+    {
+      rings.each( []( ring& r )
+      {
+        r.head = 0;
+      } );
+    }
+
+    static profiler& get()
+    {
+      static profiler instance;
+      return instance;
+    }
+  };
+
+  //records the time between its construction and destruction
+  class profile_scope
+  {
+    const char* name;
+    std::uint64_t begin;
+
+    profile_scope( const profile_scope& );
+    profile_scope& operator=( const profile_scope& );
+  public:
+    explicit profile_scope( const char* n ) : name( n ), begin( profiler::get().now() ) {}
+
+    ~profile_scope()
+    {
+      profiler::get().record( name, begin, profiler::get().now() );
+    }
+  };
+}
+
+#define CES_PROFILE_CONCAT_( a, b ) a##b
+#define CES_PROFILE_CONCAT( a, b ) CES_PROFILE_CONCAT_( a, b )
+
+#ifdef CES_PROFILE
+//times the rest of the enclosing scope under name
+#define CES_PROFILE_SCOPE( name ) ces::profile_scope CES_PROFILE_CONCAT( profile_scope_, __LINE__ )( name )
+#else
+#define CES_PROFILE_SCOPE( name )
+#endif
+
+#endif
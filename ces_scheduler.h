@@ -0,0 +1,159 @@
+#ifndef ces_scheduler_h
+#define ces_scheduler_h
+
+#include <vector>
+#include <atomic>
+#include <memory>
+#include <functional>
+#include <algorithm>
+#include <cstddef>
+
+#include "object_manager.h"
+#include "ces_thread_pool.h"
+
+namespace ces
+{
+  //unique id for any type, used to name the data a system touches
+  template< class t >
+  om::id_type type_id()
+  {
+    static char type;
+    return om::id_type( &type );
+  }
+
+  /*
+   * The data a system reads and writes. Anything can be named here, components,
+   * managers, or std::ostream for systems that print.
+   * Nothing declared means the system may touch anything, so it runs alone.
+   */
+  class access
+  {
+    std::vector< om::id_type > reads;
+    std::vector< om::id_type > writes;
+    bool exclusive;
+
+    static bool intersects( const std::vector< om::id_type >& a, const std::vector< om::id_type >& b )
+    {
+      for( auto c = a.begin(); c != a.end(); ++c )
+      {
+        if( std::find( b.begin(), b.end(), *c ) != b.end() )
+        {
+          return true;
+        }
+      }
+
+      return false;
+    }
+  public:
+    template< class t >
+    access& read()
+    {
+      reads.push_back( type_id< t >() );
+      exclusive = false;
+      return *this;
+    }
+
+    template< class t >
+    access& write()
+    {
+      writes.push_back( type_id< t >() );
+      exclusive = false;
+      return *this;
+    }
+
+    //true if the two can't run at the same time
+    bool conflicts( const access& o ) const
+    {
+      return exclusive || o.exclusive ||
+             intersects( writes, o.writes ) ||
+             intersects( writes, o.reads ) ||
+             intersects( reads, o.writes );
+    }
+
+    access() : exclusive( true ) {}
+  };
+
+  /*
+   * Runs a list of jobs on the thread pool, respecting their declared access.
+   * If two jobs conflict, the one that comes first in the list always runs first,
+   * so the result is the same as running them one after another.
+   */
+  class scheduler
+  {
+    struct node
+    {
+      std::vector< std::size_t > next; //jobs that wait for this one
+      std::size_t preds; //number of jobs this one waits for
+    };
+
+    std::vector< node > nodes;
+  public:
+    //builds the dependency graph, only needs to be done when the job list changes
+    void build( const std::vector< access >& jobs )
+    {
+      nodes.assign( jobs.size(), node() );
+
+      for( std::size_t c = 0; c < jobs.size(); ++c )
+      {
+        nodes[c].preds = 0;
+        for( std::size_t d = 0; d < c; ++d )
+        {
+          if( jobs[d].conflicts( jobs[c] ) )
+          {
+            nodes[d].next.push_back( c );
+            ++nodes[c].preds;
+          }
+        }
+      }
+    }
+
+    //calls func( job index ) for every job, returns when all of them are done
+    template< class f >
+    void run( f func )
+    {
+      if( nodes.empty() )
+      {
+        return;
+      }
+
+      thread_pool& pool = thread_pool::get();
+      std::unique_ptr< std::atomic< std::size_t >[] > waiting( new std::atomic< std::size_t >[nodes.size()] );
+      std::atomic< std::size_t > remaining( nodes.size() );
+
+      for( std::size_t c = 0; c < nodes.size(); ++c )
+      {
+        waiting[c] = nodes[c].preds;
+      }
+
+      std::function< void( std::size_t ) > launch = [&]( std::size_t i )
+      {
+        pool.submit( [&, i]
+        {
+          func( i );
+
+          for( auto c = nodes[i].next.begin(); c != nodes[i].next.end(); ++c )
+          {
+            if( --waiting[*c] == 0 )
+            {
+              launch( *c );
+            }
+          }
+
+          --remaining;
+        } );
+      };
+
+      for( std::size_t c = 0; c < nodes.size(); ++c )
+      {
+        if( nodes[c].preds == 0 )
+        {
+          launch( c );
+        }
+      }
+
+      pool.wait( remaining );
+    }
+  };
+}
+
+#endif
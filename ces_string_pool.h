@@ -0,0 +1,184 @@
+#ifndef ces_string_pool_h
+#define ces_string_pool_h
+
+#include <vector>
+#include <string>
+#include <memory>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+namespace ces
+{
+  //an interned string, equal symbols mean equal text
+  typedef std::uint32_t symbol;
+
+  /*
+   * Interns strings: each distinct text is stored once and gets a 32 bit symbol, so
+   * components and events can hold names as plain integers, comparing them is an
+   * integer compare, and nothing allocates per name.
+   *
+   * The text lives in big blocks, one string after the other, zero terminated. Blocks
+   * are never moved or freed, so the pointers str() gives stay valid. Symbols are dense,
+   * handed out from 0 (the empty string) up, so they can index arrays.
+   *
+   * Interning is not thread safe, intern at sync points or from one thread. Reading
+   * (str, length, find) is safe while nobody interns.
+   */
+  class string_pool
+  {
+  public:
+    static const symbol empty = 0; //""
+    static const symbol none = ~symbol(0); //find() didn't find it
+  private:
+    static const std::size_t block_size = 64 * 1024;
+
+    std::vector< std::unique_ptr< char[] > > blocks;
+    char* current; //block strings are added to
+    std::size_t used; //bytes of it in use
+    std::vector< const char* > strings; //indexed by symbol
+    std::vector< std::uint32_t > lengths;
+    std::vector< std::uint32_t > hashes;
+    std::vector< symbol > table; //open addressing, none if the slot is free
+
+    static std::uint32_t hash( const char* s, std::size_t len )
+    {
+      std::uint32_t h = 2166136261u; //fnv-1a
+      for( std::size_t c = 0; c < len; ++c )
+      {
+        h = ( h ^ static_cast< unsigned char >( s[c] ) ) * 16777619u;
+      }
+      return h;
+    }
+
+    //the table slot that holds the text, or the free slot where it would go
+    std::size_t probe( const char* s, std::size_t len, std::uint32_t h ) const
+    {
+      std::size_t mask = table.size() - 1;
+      for( std::size_t i = h & mask; ; i = ( i + 1 ) & mask )
+      {
+        symbol c = table[i];
+        if( c == none || ( hashes[c] == h && lengths[c] == len && std::memcmp( strings[c], s, len ) == 0 ) )
+        {
+          return i;
+        }
+      }
+    }
+
+    void grow()
+    {
+      std::vector< symbol > old( table.size() * 2, symbol( none ) );
+      table.swap( old );
+
+      std::size_t mask = table.size() - 1;
+      for( symbol c = 0; c < strings.size(); ++c )
+      {
+        std::size_t i = hashes[c] & mask;
+        while( table[i] != none )
+        {
+          i = ( i + 1 ) & mask;
+        }
+        table[i] = c;
+      }
+    }
+
+    //copies the text into the current block, long strings get a block of their own
+    const char* store( const char* s, std::size_t len )
+    {
+      char* d;
+      if( len + 1 > block_size / 4 )
+      {
+        blocks.push_back( std::unique_ptr< char[] >( new char[len + 1] ) );
+        d = blocks.back().get();
+      }
+      else
+      {
+        if( !current || used + len + 1 > block_size )
+        {
+          blocks.push_back( std::unique_ptr< char[] >( new char[block_size] ) );
+          current = blocks.back().get();
+          used = 0;
+        }
+
+        d = current + used;
+        used += len + 1;
+      }
+
+      std::memcpy( d, s, len );
+      d[len] = 0;
+      return d;
+    }
+  protected:
+    string_pool() : current( 0 ), used( 0 ), table( 64, symbol( none ) ) //singleton
+    {
+      intern( "", 0 );
+    }
+    string_pool( const string_pool& );
+    string_pool( string_pool&& );
+    string_pool& operator=( const string_pool& );
+  public:
+    symbol intern( const char* s, std::size_t len )
+    {
+      std::uint32_t h = hash( s, len );
+      std::size_t i = probe( s, len, h );
+      if( table[i] != none )
+      {
+        return table[i];
+      }
+
+      symbol result = symbol( strings.size() );
+      strings.push_back( store( s, len ) );
+      lengths.push_back( std::uint32_t( len ) );
+      hashes.push_back( h );
+      table[i] = result;
+
+      if( strings.size() * 2 > table.size() ) //at most half full
+      {
+        grow();
+      }
+
+      return result;
+    }
+
+    symbol intern( const char* s )
+    {
+      return intern( s, std::strlen( s ) );
+    }
+
+    symbol intern( const std::string& s )
+    {
+      return intern( s.data(), s.size() );
+    }
+
+    //the symbol of the text if it was interned, none otherwise, never adds
+    symbol find( const char* s ) const
+    {
+      std::size_t len = std::strlen( s );
+      return table[probe( s, len, hash( s, len ) )];
+    }
+
+    const char* str( symbol s ) const
+    {
+      return strings[s];
+    }
+
+    std::size_t length( symbol s ) const
+    {
+      return lengths[s];
+    }
+
+    //number of distinct strings
+    std::size_t size() const
+    {
+      return strings.size();
+    }
+
+    static string_pool& get()
+    {
+      static string_pool instance;
+      return instance;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,254 @@
+#ifndef ces_thread_pool_h
+#define ces_thread_pool_h
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <cstddef>
+
+namespace ces
+{
+  /*
+   * One t per thread that ever asked for one, so threads can fill their own without
+   * locking, and the owner can visit all of them at a sync point.
+   *
+   * A thread's t is made on its first local() and pushed onto a lock-free list. It is
+   * found again through a thread_local pointer, which there is one of per t, so a t
+   * can only be used in one list (eg. a type nested in a singleton).
+   */
+  template< class t >
+  class thread_list
+  {
+    struct node
+    {
+      t data;
+      node* next;
+      node() : data(), next( 0 ) {}
+    };
+
+    std::atomic< node* > head;
+
+    thread_list( const thread_list& );
+    thread_list& operator=( const thread_list& );
+  public:
+    //the calling thread's t
+    t& local()
+    {
+      static thread_local node* mine = 0;
+
+      if( !mine )
+      {
+        mine = new node;
+        mine->next = head.load();
+        while( !head.compare_exchange_weak( mine->next, mine ) );
+      }
+
+      return mine->data;
+    }
+
+    //calls func( t& ) for every thread's t, the threads mustn't touch theirs meanwhile
+    template< class f >
+    void each( f func )
+    {
+      for( node* n = head.load(); n; n = n->next )
+      {
+        func( n->data );
+      }
+    }
+
+    thread_list() : head( 0 ) {}
+
+    ~thread_list()
+    {
+      for( node* n = head.load(); n; )
+      {
+        node* next = n->next;
+        delete n;
+        n = next;
+      }
+    }
+  };
+
+  /*
+   * Work stealing thread pool, shared by everything that runs in parallel.
+   *
+   * Every thread has its own task queue, slot 0 belongs to the threads that are not
+   * workers (usually the main thread). A thread pushes and pops at the back of its own
+   * queue, and when it runs dry it steals from the front of the others.
+   * Threads that wait for work to finish help running tasks instead of blocking.
+   */
+  class thread_pool
+  {
+  public:
+    typedef std::function< void() > task;
+  private:
+    struct queue
+    {
+      std::mutex lock;
+      std::deque< task > tasks;
+    };
+
+    std::vector< std::thread > threads;
+    std::vector< queue* > queues;
+    std::atomic< bool > running;
+    std::atomic< std::size_t > pending; //queued, not yet started tasks
+    std::mutex sleep_lock;
+    std::condition_variable wake;
+
+    static std::size_t& slot()
+    {
+      static thread_local std::size_t s = 0;
+      return s;
+    }
+
+    bool pop( std::size_t self, task& t )
+    {
+      std::lock_guard< std::mutex > l( queues[self]->lock );
+      if( queues[self]->tasks.empty() )
+      {
+        return false;
+      }
+
+      t = std::move( queues[self]->tasks.back() );
+      queues[self]->tasks.pop_back();
+      return true;
+    }
+
+    bool steal( std::size_t self, task& t )
+    {
+      for( std::size_t c = 1; c < queues.size(); ++c )
+      {
+        queue* victim = queues[( self + c ) % queues.size()];
+        std::lock_guard< std::mutex > l( victim->lock );
+        if( !victim->tasks.empty() )
+        {
+          t = std::move( victim->tasks.front() );
+          victim->tasks.pop_front();
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    void loop( std::size_t self )
+    {
+      slot() = self;
+
+      while( running )
+      {
+        if( !run_one() )
+        {
+          std::unique_lock< std::mutex > l( sleep_lock );
+          wake.wait( l, [this]{ return !running || pending > 0; } );
+        }
+      }
+    }
+  protected:
+    thread_pool( const thread_pool& );
+    thread_pool( thread_pool&& );
+    thread_pool& operator=( const thread_pool& );
+  public:
+    //runs one queued task on the calling thread, returns false if there was none
+    bool run_one()
+    {
+      task t;
+      if( pop( slot(), t ) || steal( slot(), t ) )
+      {
+        --pending;
+        t();
+        return true;
+      }
+
+      return false;
+    }
+
+    void submit( task t )
+    {
+      {
+        std::lock_guard< std::mutex > l( queues[slot()]->lock );
+        queues[slot()]->tasks.push_back( std::move( t ) );
+      }
+
+      ++pending;
+
+      {
+        std::lock_guard< std::mutex > l( sleep_lock ); //so the wakeup can't slip in between a worker's check and its wait
+      }
+      wake.notify_one();
+    }
+
+    //helps running tasks until the counter drops to zero
+    void wait( const std::atomic< std::size_t >& remaining )
+    {
+      while( remaining > 0 )
+      {
+        if( !run_one() )
+        {
+          std::this_thread::yield();
+        }
+      }
+    }
+
+    //number of threads that can run tasks, including slot 0
+    std::size_t size()
+    {
+      return queues.size();
+    }
+
+    //slot of the calling thread, in [0, size())
+    static std::size_t current()
+    {
+      return slot();
+    }
+
+    thread_pool( std::size_t count = std::thread::hardware_concurrency() ) : running( true ), pending( 0 )
+    {
+      if( count == 0 )
+      {
+        count = 1;
+      }
+
+      for( std::size_t c = 0; c < count; ++c )
+      {
+        queues.push_back( new queue );
+      }
+
+      for( std::size_t c = 1; c < count; ++c )
+      {
+        threads.push_back( std::thread( &thread_pool::loop, this, c ) );
+      }
+    }
+
+    ~thread_pool()
+    {
+      {
+        std::lock_guard< std::mutex > l( sleep_lock );
+        running = false;
+      }
+      wake.notify_all();
+
+      for( auto c = threads.begin(); c != threads.end(); ++c )
+      {
+        c->join();
+      }
+
+      for( auto c = queues.begin(); c != queues.end(); ++c )
+      {
+        delete *c;
+      }
+    }
+
+    static thread_pool& get()
+    {
+      static thread_pool instance;
+      return instance;
+    }
+  };
+}
+
+#endif
@@ -0,0 +1,416 @@
+#ifndef component_hierarchy_h
+#define component_hierarchy_h
+
+#include <vector>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+
+#include "object_manager.h"
+
+namespace om
+{
+
+/*
+ * Parent / child relationships between entities, with a local and a world value
+ * (a position, a transform) per entity.
+ *
+ * The nodes live in an object_manager, sorted by depth, and the children of a
+ * parent next to each other (breadth first order). A parent always comes before its
+ * children, so propagate() computes every world value in one pass over the buffer,
+ * reading the parent's finished world value a few slots back.
+ *
+ * add() appends, which keeps parents first but not the depth order. reparent(),
+ * remove_subtree() and unlink() only queue, the structure changes in apply(), all
+ * at once, then the buffer is sorted again. Until then propagate() works on the old
+ * structure. Each apply() is linear in the number of nodes.
+ *
+ * Entities destroyed some other way than remove_subtree() have to be unlink()-ed,
+ * or their nodes stay, and the next entity with their index is mistaken for them.
+ */
+template< class t >
+class hierarchy
+{
+public:
+	struct node
+	{
+		id_type entity;
+		id_type parent; //entity id of the parent, index_mask for roots
+		std::size_t parent_slot; //position of the parent in the buffer
+		std::uint32_t depth; //0 for roots
+		t local;
+		t world; //set by propagate()
+	};
+private:
+	struct entry
+	{
+		id_type entity; //full id of the owner, index_mask if the slot is empty
+		id_type node; //handle into the object manager
+		entry() : entity( index_mask ), node( index_mask ) {}
+	};
+
+	enum
+	{
+		cut = 1, //in a removed subtree, reported to apply()'s caller
+		unlinked //the entity is gone already
+	};
+
+	object_manager< node > nodes;
+	std::vector< entry > sparse; //indexed by entity index bits
+	std::vector< std::pair< id_type, id_type > > moves; //entity, new parent
+	std::vector< id_type > cuts; //roots of subtrees to remove
+	std::vector< id_type > unlinks; //handles of nodes whose entity is gone
+	bool sorted;
+
+	//scratch of apply(), kept to avoid reallocating
+	std::vector< std::uint32_t > depths;
+	std::vector< char > dead; //0, cut or unlinked
+	std::vector< std::size_t > path, first_child, children, order, new_slot;
+	std::vector< id_type > handles;
+
+	hierarchy( const hierarchy& );
+	hierarchy& operator=( const hierarchy& );
+
+	node& get( id_type entity_id )
+	{
+		return nodes.lookup( sparse[entity_id & index_mask].node );
+	}
+
+	std::size_t slot_of( id_type entity_id )
+	{
+		return nodes.slot( sparse[entity_id & index_mask].node );
+	}
+
+	//whether entity_id is ancestor_id or under it
+	bool descends( id_type entity_id, id_type ancestor_id )
+	{
+		for( id_type c = entity_id; c != index_mask; c = get( c ).parent )
+		{
+			if( c == ancestor_id )
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//unlinked nodes are dropped quietly, their children become roots where they are
+	//needs the parent slots, they are valid between two apply() calls
+	void orphan()
+	{
+		std::vector< std::pair< id_type, node > >& o = nodes.get_objects();
+		dead.assign( o.size(), 0 );
+
+		for( auto c = unlinks.begin(); c != unlinks.end(); ++c )
+		{
+			dead[nodes.slot( *c )] = unlinked;
+		}
+
+		for( std::size_t c = 0; c < o.size(); ++c )
+		{
+			node& n = o[c].second;
+			if( n.parent != index_mask && dead[n.parent_slot] == unlinked )
+			{
+				n.parent = index_mask;
+				n.parent_slot = c;
+				n.local = n.world;
+			}
+		}
+	}
+
+	//depth of every node, and whether it is in a removed subtree
+	void resolve()
+	{
+		const std::uint32_t unknown = ~std::uint32_t( 0 );
+		std::vector< std::pair< id_type, node > >& o = nodes.get_objects();
+		depths.assign( o.size(), unknown );
+
+		for( auto c = cuts.begin(); c != cuts.end(); ++c )
+		{
+			if( has( *c ) && !dead[slot_of( *c )] )
+			{
+				dead[slot_of( *c )] = cut;
+			}
+		}
+
+		//walks up to the first node that is known, then fills in the path back down
+		for( std::size_t c = 0; c < o.size(); ++c )
+		{
+			for( std::size_t s = c; depths[s] == unknown; s = o[s].second.parent_slot )
+			{
+				path.push_back( s );
+				if( o[s].second.parent == index_mask )
+				{
+					break;
+				}
+			}
+
+			while( !path.empty() )
+			{
+				std::size_t s = path.back();
+				path.pop_back();
+
+				node& n = o[s].second;
+				if( n.parent == index_mask )
+				{
+					depths[s] = 0;
+				}
+				else
+				{
+					depths[s] = depths[n.parent_slot] + 1;
+					if( !dead[s] && dead[n.parent_slot] )
+					{
+						dead[s] = cut;
+					}
+				}
+				n.depth = depths[s];
+			}
+		}
+	}
+
+	//puts the live nodes in breadth first order and the dead ones behind them
+	//returns the number of live nodes
+	std::size_t sort()
+	{
+		std::vector< std::pair< id_type, node > >& o = nodes.get_objects();
+		std::size_t n = o.size();
+
+		//the children of each node next to each other, a counting sort by parent slot
+		first_child.assign( n + 1, 0 );
+		for( std::size_t c = 0; c < n; ++c )
+		{
+			if( !dead[c] && o[c].second.parent != index_mask )
+			{
+				++first_child[o[c].second.parent_slot + 1];
+			}
+		}
+		for( std::size_t c = 1; c <= n; ++c )
+		{
+			first_child[c] += first_child[c - 1];
+		}
+
+		children.resize( first_child[n] );
+		new_slot.assign( first_child.begin(), first_child.end() - 1 ); //fill position of each parent
+		for( std::size_t c = 0; c < n; ++c )
+		{
+			if( !dead[c] && o[c].second.parent != index_mask )
+			{
+				children[new_slot[o[c].second.parent_slot]++] = c;
+			}
+		}
+
+		//the roots in their current order, then the children of each node in the order it was placed
+		order.clear();
+		order.reserve( n );
+		for( std::size_t c = 0; c < n; ++c )
+		{
+			if( !dead[c] && o[c].second.parent == index_mask )
+			{
+				order.push_back( c );
+			}
+		}
+		for( std::size_t c = 0; c < order.size(); ++c )
+		{
+			order.insert( order.end(), children.begin() + first_child[order[c]], children.begin() + first_child[order[c] + 1] );
+		}
+
+		std::size_t live = order.size();
+		for( std::size_t c = 0; c < n; ++c )
+		{
+			if( dead[c] )
+			{
+				order.push_back( c );
+			}
+		}
+
+		for( std::size_t c = 0; c < n; ++c )
+		{
+			new_slot[order[c]] = c;
+		}
+
+		for( std::size_t c = 0; c < n; ++c )
+		{
+			node& d = o[c].second;
+			d.parent_slot = d.parent == index_mask ? new_slot[c] : new_slot[d.parent_slot];
+		}
+
+		nodes.reorder( order );
+		return live;
+	}
+protected:
+public:
+	typedef t value_type;
+
+	//adds an entity under parent_id (index_mask for a root), the parent has to be in already
+	id_type add( id_type entity_id, id_type parent_id = index_mask, const t& local = t() )
+	{
+		node d;
+		d.entity = entity_id;
+		d.parent = parent_id;
+		d.parent_slot = parent_id == index_mask ? nodes.get_objects().size() : slot_of( parent_id );
+		d.depth = parent_id == index_mask ? 0 : get( parent_id ).depth + 1;
+		d.local = local;
+		d.world = local;
+
+		id_type handle = nodes.add( d );
+
+		if( ( entity_id & index_mask ) >= sparse.size() )
+		{
+			sparse.resize( ( entity_id & index_mask ) + 1 );
+		}
+		sparse[entity_id & index_mask].entity = entity_id;
+		sparse[entity_id & index_mask].node = handle;
+
+		sorted = false;
+		return handle;
+	}
+
+	bool has( id_type entity_id )
+	{
+		return ( entity_id & index_mask ) < sparse.size() && sparse[entity_id & index_mask].entity == entity_id;
+	}
+
+	//only valid if has() is true
+	t& get_local( id_type entity_id )
+	{
+		return get( entity_id ).local;
+	}
+
+	//as of the last propagate()
+	const t& get_world( id_type entity_id )
+	{
+		return get( entity_id ).world;
+	}
+
+	id_type get_parent( id_type entity_id )
+	{
+		return get( entity_id ).parent;
+	}
+
+	//moves the entity, with its subtree, under parent_id (index_mask makes it a root) on apply()
+	//ignored if the parent is gone by then, or is in the entity's subtree
+	void reparent( id_type entity_id, id_type parent_id )
+	{
+		moves.push_back( std::make_pair( entity_id, parent_id ) );
+	}
+
+	//removes the entity and everything under it on apply(), after the reparenting
+	void remove_subtree( id_type entity_id )
+	{
+		cuts.push_back( entity_id );
+	}
+
+	//does the queued reparents and removes, then sorts
+	//on_remove( entity id ) is called for each removed node, eg. to destroy the entity
+	template< class g >
+	void apply( g on_remove )
+	{
+		if( moves.empty() && cuts.empty() && unlinks.empty() && sorted )
+		{
+			return;
+		}
+
+		orphan();
+
+		for( auto c = moves.begin(); c != moves.end(); ++c )
+		{
+			if( has( c->first ) && ( c->second == index_mask || ( has( c->second ) && !descends( c->second, c->first ) ) ) )
+			{
+				node& d = get( c->first );
+				d.parent = c->second;
+				d.parent_slot = c->second == index_mask ? slot_of( c->first ) : slot_of( c->second );
+			}
+		}
+
+		resolve();
+		std::size_t live = sort();
+
+		//the removed ones are at the end now, so nothing moves when they go
+		std::vector< std::pair< id_type, node > >& o = nodes.get_objects();
+		handles.clear();
+		for( std::size_t c = live; c < o.size(); ++c )
+		{
+			if( dead[order[c]] == cut )
+			{
+				on_remove( o[c].second.entity );
+				sparse[o[c].second.entity & index_mask] = entry();
+			}
+			handles.push_back( o[c].first );
+		}
+		nodes.remove_n( handles.data(), handles.size() );
+
+		moves.clear();
+		cuts.clear();
+		unlinks.clear();
+		sorted = true;
+	}
+
+	void apply()
+	{
+		apply( []( id_type ){} );
+	}
+
+	//forgets an entity that was destroyed, its children become roots on apply(), staying where they are
+	//the entity is gone right away, so its index can be reused before that
+	void unlink( id_type entity_id )
+	{
+		if( has( entity_id ) )
+		{
+			unlinks.push_back( sparse[entity_id & index_mask].node );
+			sparse[entity_id & index_mask] = entry();
+		}
+	}
+
+	//world = combine( parent's world, local ) for every node, local for roots
+	template< class f >
+	void propagate( f combine )
+	{
+		std::vector< std::pair< id_type, node > >& o = nodes.get_objects();
+		for( auto c = o.begin(); c != o.end(); ++c )
+		{
+			node& n = c->second;
+			n.world = n.parent == index_mask ? n.local : combine( o[n.parent_slot].second.world, n.local );
+		}
+	}
+
+	std::size_t size()
+	{
+		return nodes.get_objects().size();
+	}
+
+	//the nodes, parents before children
+	object_manager< node >& get_data()
+	{
+		return nodes;
+	}
+
+	//rebuilds the entity index from the nodes, after they were restored
+	//queued changes are dropped, apply() them before saving
+	void rebuild_index()
+	{
+		sparse.clear();
+		std::vector< std::pair< id_type, node > >& o = nodes.get_objects();
+		for( auto c = o.begin(); c != o.end(); ++c )
+		{
+			if( ( c->second.entity & index_mask ) >= sparse.size() )
+			{
+				sparse.resize( ( c->second.entity & index_mask ) + 1 );
+			}
+
+			sparse[c->second.entity & index_mask].entity = c->second.entity;
+			sparse[c->second.entity & index_mask].node = c->first;
+		}
+
+		moves.clear();
+		cuts.clear();
+		unlinks.clear();
+		sorted = false;
+	}
+
+	hierarchy() : sorted( true ) {}
+};
+
+}
+
+#endif
@@ -0,0 +1,128 @@
+#ifndef component_name_index_h
+#define component_name_index_h
+
+#include <vector>
+#include <cstdint>
+
+#include "object_manager.h"
+
+namespace om
+{
+
+/*
+ * Name -> entity index over interned names (see ces_string_pool.h).
+ *
+ * Symbols are dense, so the index is an array indexed by symbol holding the first
+ * entity with that name. Entities that share a name are linked through an array
+ * indexed by their index bits. Finding, adding and removing are all O(1), no hashing.
+ */
+class name_index
+{
+private:
+	struct link
+	{
+		id_type entity; //index_mask if the entity isn't indexed
+		id_type prev, next; //entities with the same name, index_mask at the ends
+		std::uint32_t name;
+		link() : entity( index_mask ), prev( index_mask ), next( index_mask ), name( 0 ) {}
+	};
+
+	std::vector< id_type > heads; //indexed by symbol, index_mask if nobody has the name
+	std::vector< link > links; //indexed by entity index bits
+
+	name_index( const name_index& );
+	name_index& operator=( const name_index& );
+
+	//takes whichever entity has the index out of its list
+	void unlink( id_type i )
+	{
+		link& l = links[i];
+		if( l.prev != index_mask )
+		{
+			links[l.prev & index_mask].next = l.next;
+		}
+		else
+		{
+			heads[l.name] = l.next;
+		}
+
+		if( l.next != index_mask )
+		{
+			links[l.next & index_mask].prev = l.prev;
+		}
+
+		l = link();
+	}
+protected:
+public:
+	bool has( id_type entity_id ) const
+	{
+		return ( entity_id & index_mask ) < links.size() && links[entity_id & index_mask].entity == entity_id;
+	}
+
+	//gives the entity a name, replacing the one it had, or the one a dead entity with its index had
+	void add( id_type entity_id, std::uint32_t name )
+	{
+		if( ( entity_id & index_mask ) < links.size() && links[entity_id & index_mask].entity != index_mask )
+		{
+			unlink( entity_id & index_mask );
+		}
+
+		if( name >= heads.size() )
+		{
+			heads.resize( name + 1, index_mask );
+		}
+
+		if( ( entity_id & index_mask ) >= links.size() )
+		{
+			links.resize( ( entity_id & index_mask ) + 1 );
+		}
+
+		link& l = links[entity_id & index_mask];
+		l.entity = entity_id;
+		l.name = name;
+		l.prev = index_mask;
+		l.next = heads[name];
+		if( l.next != index_mask )
+		{
+			links[l.next & index_mask].prev = entity_id;
+		}
+		heads[name] = entity_id;
+	}
+
+	void remove( id_type entity_id )
+	{
+		if( has( entity_id ) )
+		{
+			unlink( entity_id & index_mask );
+		}
+	}
+
+	//an entity with the name, the one named last, index_mask if there is none
+	id_type find( std::uint32_t name ) const
+	{
+		return name < heads.size() ? heads[name] : index_mask;
+	}
+
+	//calls func( entity id ) for every entity with the name
+	template< class f >
+	void each( std::uint32_t name, f func ) const
+	{
+		for( id_type c = find( name ); c != index_mask; c = links[c & index_mask].next )
+		{
+			func( c );
+		}
+	}
+
+	void clear()
+	{
+		heads.clear();
+		links.clear();
+	}
+
+	name_index() {}
+};
+
+}
+
+#endif
@@ -0,0 +1,95 @@
+#ifndef component_reactive_h
+#define component_reactive_h
+
+#include <cstdint>
+
+#include "component_store.h"
+
+namespace om
+{
+
+/*
+ * Lets a system visit only the components that were added, changed or removed
+ * since its last visit, instead of all of them every frame.
+ *
+ * The filter picks the kinds of changes to report. The store's change tracking is
+ * turned on when the first reactive is made, changes are mutable lookups, adds and
+ * removes (see object_manager). Writes made through iterators have to be reported
+ * with touch().
+ *
+ * Each visit closes the store's current version, so changes made while visiting
+ * (even to the visited store) show up on the next visit. The store keeps its log
+ * until every reactive over it has seen it. Closing versions and dropping the log
+ * writes to the store, so a system visiting a reactive writes the component too.
+ */
+template< class s >
+class reactive
+{
+private:
+	s& store;
+	unsigned filter;
+	std::uint32_t seen; //last version visited
+
+	reactive( const reactive& );
+	reactive& operator=( const reactive& );
+protected:
+public:
+	typedef typename s::value_type value_type;
+
+	enum
+	{
+		on_added = 1 << change::added,
+		on_changed = 1 << change::changed,
+		on_removed = 1 << change::removed
+	};
+
+	//func( entity id, const component& ) for the added and changed components
+	//on_remove( entity id ) for the entities that lost their component
+	template< class f, class g >
+	void each( f func, g on_remove )
+	{
+		std::uint32_t now = store.commit();
+
+		store.changes_since( seen, [&]( const change& c, id_type entity_id )
+		{
+			if( c.version > now || !( filter & ( 1 << c.kind ) ) )
+			{
+				return;
+			}
+
+			if( c.kind == change::removed )
+			{
+				on_remove( entity_id );
+			}
+			else
+			{
+				func( entity_id, store.get_data().read( c.id ) );
+			}
+		} );
+
+		seen = now;
+		store.forget_read();
+	}
+
+	template< class f >
+	void each( f func )
+	{
+		each( func, []( id_type ){} );
+	}
+
+	reactive( s& st, unsigned f ) : store( st ), filter( f ), seen( 0 )
+	{
+		store.enable_tracking();
+		seen = store.get_data().get_version() - 1; //changes from the current version on
+		store.add_reader( &seen );
+	}
+
+	~reactive()
+	{
+		store.remove_reader( &seen );
+	}
+};
+
+}
+
+#endif
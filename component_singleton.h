@@ -0,0 +1,107 @@
+#ifndef component_singleton_h
+#define component_singleton_h
+
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <cstddef>
+
+namespace om
+{
+
+/*
+ * Components that exist once per world instead of once per entity (the frame's
+ * clock, settings, input state), held by type.
+ *
+ * get() makes a missing one, so do the first get() of each type before systems run
+ * in parallel, eg. in init(). After that every access is an array lookup.
+ */
+class singleton_store
+{
+private:
+	struct holder_base
+	{
+		virtual ~holder_base() {}
+	};
+
+	template< class t >
+	struct holder : holder_base
+	{
+		t data;
+		holder() : data() {}
+		holder( const t& d ) : data( d ) {}
+	};
+
+	std::vector< std::unique_ptr< holder_base > > slots; //indexed by type number
+
+	static std::size_t next_type()
+	{
+		static std::atomic< std::size_t > count( 0 );
+		return count++;
+	}
+
+	//the same in every store
+	template< class t >
+	static std::size_t type_number()
+	{
+		static const std::size_t number = next_type();
+		return number;
+	}
+
+	template< class t >
+	t& put( holder< t >* h )
+	{
+		std::size_t n = type_number< t >();
+		if( n >= slots.size() )
+		{
+			slots.resize( n + 1 );
+		}
+
+		slots[n].reset( h );
+		return h->data;
+	}
+
+	singleton_store( const singleton_store& );
+	singleton_store& operator=( const singleton_store& );
+protected:
+public:
+	template< class t >
+	bool has()
+	{
+		return type_number< t >() < slots.size() && slots[type_number< t >()];
+	}
+
+	//makes the singleton, or replaces it
+	template< class t >
+	t& set( const t& d )
+	{
+		return put( new holder< t >( d ) );
+	}
+
+	//default constructs the singleton if there is none yet, t doesn't have to be copyable
+	template< class t >
+	t& get()
+	{
+		if( !has< t >() )
+		{
+			return put( new holder< t >() );
+		}
+
+		return static_cast< holder< t >* >( slots[type_number< t >()].get() )->data;
+	}
+
+	template< class t >
+	void remove()
+	{
+		if( has< t >() )
+		{
+			slots[type_number< t >()].reset();
+		}
+	}
+
+	singleton_store() {}
+};
+
+}
+
+#endif
@@ -0,0 +1,393 @@
+#ifndef component_spatial_h
+#define component_spatial_h
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <algorithm>
+#include <cmath>
+#include <climits>
+#include <cstdint>
+
+#include "component_store.h"
+#include "component_reactive.h"
+
+namespace om
+{
+
+/*
+ * Uniform hash grid over a store of positions, for "who is near this point" queries
+ * without scanning the whole store.
+ *
+ * The components have to have float x, y and z members. The grid is filled from the
+ * store when it is made, then update() moves only the entities whose position was
+ * added, changed or removed since the last update (through a reactive, so the same
+ * rules apply: changes are mutable lookups, writes through iterators need touch()).
+ * Queries see the positions as of the last update.
+ *
+ * Entities are bucketed by cell, each bucket holds the positions as well, so a query
+ * reads the buckets of the cells it overlaps and nothing else. A cell size about the
+ * typical query radius works best.
+ */
+template< class s >
+class spatial_grid
+{
+private:
+	struct point
+	{
+		id_type entity;
+		float x, y, z;
+	};
+
+	struct entry
+	{
+		id_type entity; //index_mask if the entity isn't in the grid
+		std::uint64_t cell;
+		std::uint32_t slot; //in the cell's bucket
+		entry() : entity( index_mask ), cell( 0 ), slot( 0 ) {}
+	};
+
+	static const int cell_bits = 21; //per axis, three of them make a key
+	static const int cell_min = -( 1 << ( cell_bits - 1 ) );
+	static const int cell_max = ( 1 << ( cell_bits - 1 ) ) - 1;
+
+	s& store;
+	reactive< s > changes;
+	float cell_size;
+	std::unordered_map< std::uint64_t, std::vector< point > > cells;
+	std::vector< entry > entities; //indexed by entity index bits
+	std::size_t count;
+	int lo[3], hi[3]; //the cells with entities are within these
+	bool loose; //a cell on the bounds was emptied, update() shrinks them
+
+	spatial_grid( const spatial_grid& );
+	spatial_grid& operator=( const spatial_grid& );
+
+	//positions far out (and NaNs) are clamped into the edge cells
+	int to_cell( float v ) const
+	{
+		float f = std::floor( v / cell_size );
+		if( !( f >= float( cell_min ) ) )
+		{
+			return cell_min;
+		}
+		return f > float( cell_max ) ? cell_max : int( f );
+	}
+
+	static std::uint64_t key( int x, int y, int z )
+	{
+		const std::uint64_t mask = ( std::uint64_t( 1 ) << cell_bits ) - 1;
+		return ( std::uint64_t( x - cell_min ) & mask ) << ( 2 * cell_bits ) |
+		       ( std::uint64_t( y - cell_min ) & mask ) << cell_bits |
+		       ( std::uint64_t( z - cell_min ) & mask );
+	}
+
+	static int axis( std::uint64_t k, int a )
+	{
+		const std::uint64_t mask = ( std::uint64_t( 1 ) << cell_bits ) - 1;
+		return int( k >> ( ( 2 - a ) * cell_bits ) & mask ) + cell_min;
+	}
+
+	void erase( entry& e )
+	{
+		auto c = cells.find( e.cell );
+		std::vector< point >& bucket = c->second;
+		bucket[e.slot] = bucket.back();
+		bucket.pop_back();
+		if( e.slot < bucket.size() )
+		{
+			entities[bucket[e.slot].entity & index_mask].slot = e.slot;
+		}
+		else if( bucket.empty() )
+		{
+			cells.erase( c );
+			for( int a = 0; a < 3; ++a )
+			{
+				loose = loose || axis( e.cell, a ) == lo[a] || axis( e.cell, a ) == hi[a];
+			}
+		}
+
+		e.entity = index_mask;
+		--count;
+	}
+
+	//recomputes the bounds from the cells that are left
+	void shrink()
+	{
+		for( int a = 0; a < 3; ++a )
+		{
+			lo[a] = INT_MAX;
+			hi[a] = INT_MIN;
+		}
+
+		for( auto c = cells.begin(); c != cells.end(); ++c )
+		{
+			for( int a = 0; a < 3; ++a )
+			{
+				lo[a] = std::min( lo[a], axis( c->first, a ) );
+				hi[a] = std::max( hi[a], axis( c->first, a ) );
+			}
+		}
+
+		loose = false;
+	}
+
+	//adds the entity, or moves it if it is in already
+	void place( id_type entity_id, float x, float y, float z )
+	{
+		if( ( entity_id & index_mask ) >= entities.size() )
+		{
+			entities.resize( ( entity_id & index_mask ) + 1 );
+		}
+
+		int c[3] = { to_cell( x ), to_cell( y ), to_cell( z ) };
+		std::uint64_t k = key( c[0], c[1], c[2] );
+		point p = { entity_id, x, y, z };
+
+		entry& e = entities[entity_id & index_mask];
+		if( e.entity == entity_id && e.cell == k )
+		{
+			cells[k][e.slot] = p;
+			return;
+		}
+
+		if( e.entity != index_mask )
+		{
+			erase( e );
+		}
+
+		std::vector< point >& bucket = cells[k];
+		e.entity = entity_id;
+		e.cell = k;
+		e.slot = std::uint32_t( bucket.size() );
+		bucket.push_back( p );
+		++count;
+
+		for( int a = 0; a < 3; ++a )
+		{
+			lo[a] = std::min( lo[a], c[a] );
+			hi[a] = std::max( hi[a], c[a] );
+		}
+	}
+
+	void remove( id_type entity_id )
+	{
+		if( ( entity_id & index_mask ) < entities.size() && entities[entity_id & index_mask].entity == entity_id )
+		{
+			erase( entities[entity_id & index_mask] );
+		}
+	}
+
+	//calls func( point ) for each entity in the cells that overlap the box
+	template< class f >
+	void each_near( const float* from, const float* to, f func )
+	{
+		int a[3], b[3];
+		double overlapped = 1;
+		for( int c = 0; c < 3; ++c )
+		{
+			a[c] = std::max( to_cell( from[c] ), lo[c] );
+			b[c] = std::min( to_cell( to[c] ), hi[c] );
+			if( a[c] > b[c] )
+			{
+				return;
+			}
+			overlapped *= double( b[c] - a[c] + 1 );
+		}
+
+		//a box bigger than the populated part of the world is cheaper to do bucket by bucket
+		if( overlapped > double( cells.size() ) )
+		{
+			for( auto c = cells.begin(); c != cells.end(); ++c )
+			{
+				for( auto p = c->second.begin(); p != c->second.end(); ++p )
+				{
+					func( *p );
+				}
+			}
+			return;
+		}
+
+		for( int x = a[0]; x <= b[0]; ++x )
+		{
+			for( int y = a[1]; y <= b[1]; ++y )
+			{
+				for( int z = a[2]; z <= b[2]; ++z )
+				{
+					visit( x, y, z, func );
+				}
+			}
+		}
+	}
+
+	template< class f >
+	void visit( int x, int y, int z, f& func )
+	{
+		auto c = cells.find( key( x, y, z ) );
+		if( c != cells.end() )
+		{
+			for( auto p = c->second.begin(); p != c->second.end(); ++p )
+			{
+				func( *p );
+			}
+		}
+	}
+
+	static float distance2( const point& p, const float* center )
+	{
+		float dx = p.x - center[0], dy = p.y - center[1], dz = p.z - center[2];
+		return dx * dx + dy * dy + dz * dz;
+	}
+protected:
+public:
+	//brings the grid up to date with the store
+	void update()
+	{
+		changes.each( [&]( id_type entity_id, const typename s::value_type& d )
+		{
+			place( entity_id, d.x, d.y, d.z );
+		},
+		[&]( id_type entity_id )
+		{
+			remove( entity_id );
+		} );
+
+		if( loose )
+		{
+			shrink();
+		}
+	}
+
+	//appends the entities within the box (bounds included) to out
+	void query_box( const float* from, const float* to, std::vector< id_type >& out )
+	{
+		each_near( from, to, [&]( const point& p )
+		{
+			if( p.x >= from[0] && p.x <= to[0] && p.y >= from[1] && p.y <= to[1] && p.z >= from[2] && p.z <= to[2] )
+			{
+				out.push_back( p.entity );
+			}
+		} );
+	}
+
+	//appends the entities at most radius away from center to out
+	void query_radius( const float* center, float radius, std::vector< id_type >& out )
+	{
+		float from[3] = { center[0] - radius, center[1] - radius, center[2] - radius };
+		float to[3] = { center[0] + radius, center[1] + radius, center[2] + radius };
+
+		each_near( from, to, [&]( const point& p )
+		{
+			if( distance2( p, center ) <= radius * radius )
+			{
+				out.push_back( p.entity );
+			}
+		} );
+	}
+
+	//appends the k entities closest to center to out, closest first
+	void query_nearest( const float* center, std::size_t k, std::vector< id_type >& out )
+	{
+		k = std::min( k, count );
+		if( !k )
+		{
+			return;
+		}
+
+		std::vector< std::pair< float, id_type > > best; //max heap of the closest so far
+		auto consider = [&]( const point& p )
+		{
+			std::pair< float, id_type > candidate( distance2( p, center ), p.entity );
+			if( best.size() < k )
+			{
+				best.push_back( candidate );
+				std::push_heap( best.begin(), best.end() );
+			}
+			else if( candidate < best.front() )
+			{
+				std::pop_heap( best.begin(), best.end() );
+				best.back() = candidate;
+				std::push_heap( best.begin(), best.end() );
+			}
+		};
+
+		//rings of cells around the center's cell, until nothing outside can be closer
+		int c[3] = { to_cell( center[0] ), to_cell( center[1] ), to_cell( center[2] ) };
+		int last = 0;
+		for( int a = 0; a < 3; ++a )
+		{
+			last = std::max( last, std::max( hi[a] - c[a], c[a] - lo[a] ) );
+		}
+
+		for( int r = 0; r <= last; ++r )
+		{
+			//once the cube of cells is bigger than the populated part of the world, scan the buckets instead
+			double side_length = double( 2 * r + 1 );
+			if( side_length * side_length * side_length > double( cells.size() ) )
+			{
+				best.clear();
+				for( auto b = cells.begin(); b != cells.end(); ++b )
+				{
+					for( auto p = b->second.begin(); p != b->second.end(); ++p )
+					{
+						consider( *p );
+					}
+				}
+				break;
+			}
+
+			for( int x = c[0] - r; x <= c[0] + r; ++x )
+			{
+				for( int y = c[1] - r; y <= c[1] + r; ++y )
+				{
+					bool side = x == c[0] - r || x == c[0] + r || y == c[1] - r || y == c[1] + r;
+					for( int z = c[2] - r; z <= c[2] + r; z += side ? 1 : std::max( 2 * r, 1 ) )
+					{
+						visit( x, y, z, consider );
+					}
+				}
+			}
+
+			//everything not visited yet is outside the cube of cells visited so far
+			float reach = float( r + 1 ) * cell_size;
+			for( int a = 0; a < 3; ++a )
+			{
+				reach = std::min( reach, std::min( center[a] - float( c[a] - r ) * cell_size, float( c[a] + r + 1 ) * cell_size - center[a] ) );
+			}
+			if( best.size() == k && reach > 0 && best.front().first <= reach * reach )
+			{
+				break;
+			}
+		}
+
+		std::sort_heap( best.begin(), best.end() );
+		for( auto b = best.begin(); b != best.end(); ++b )
+		{
+			out.push_back( b->second );
+		}
+	}
+
+	std::size_t size()
+	{
+		return count;
+	}
+
+	float get_cell_size()
+	{
+		return cell_size;
+	}
+
+	spatial_grid( s& st, float size ) : store( st ), changes( st, reactive< s >::on_added | reactive< s >::on_changed | reactive< s >::on_removed ), cell_size( size ), count( 0 )
+	{
+		shrink();
+
+		for( auto c = store.begin(); c != store.end(); ++c )
+		{
+			place( c->second.id, c->second.x, c->second.y, c->second.z );
+		}
+	}
+};
+
+}
+
+#endif
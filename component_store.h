@@ -0,0 +1,300 @@
+#ifndef component_store_h
+#define component_store_h
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <cassert>
+
+#include "object_manager.h"
+
+namespace om
+{
+
+/*
+ * A store can be owned by one group (see component_view.h), which gets told about
+ * every add and remove so it can keep its components packed at the front.
+ */
+class group_base
+{
+public:
+	virtual void on_add( id_type entity_id ) = 0; //called after the component was added
+	virtual void on_remove( id_type entity_id ) = 0; //called before the component is removed
+	virtual ~group_base() {}
+};
+
+/*
+ * Component storage with an entity -> component reverse index.
+ *
+ * The components themselves live in an object_manager, so handles and iteration work
+ * the same way. Next to it there is a sparse array indexed by the index bits of the
+ * owning entity's id, which holds the full entity id (for the generation check) and
+ * the handle of its component. An entity can own at most one component per store.
+ *
+ * t has to have an 'id' member, which is set to the owning entity's id on add.
+ */
+template< class t >
+class component_store
+{
+private:
+	struct entry
+	{
+		id_type entity; //full id of the owner, index_mask if the slot is empty
+		id_type component; //handle into the object manager
+		entry() : entity( index_mask ), component( index_mask ) {}
+	};
+
+	object_manager< t > components;
+	std::vector< entry > sparse; //indexed by entity index bits
+	group_base* owner;
+	std::vector< change > removed; //entities that lost their component, while tracking
+	std::vector< const std::uint32_t* > readers; //last version each reader has seen
+
+	void log_removed( id_type entity_id )
+	{
+		if( components.is_tracking() )
+		{
+			change c = { entity_id, components.get_version(), change::removed };
+			removed.push_back( c );
+		}
+	}
+protected:
+public:
+	typedef t value_type;
+	typedef typename object_manager< t >::iter iter;
+
+	id_type add( id_type entity_id, const t& d = t() )
+	{
+		//a second component would leave the first one behind, unreachable through the entity
+		assert( !has_for_entity( entity_id ) && "the entity already has this component" );
+
+		id_type handle = components.add( d );
+		components.lookup( handle ).id = entity_id;
+
+		if( ( entity_id & index_mask ) >= sparse.size() )
+		{
+			sparse.resize( ( entity_id & index_mask ) + 1 );
+		}
+
+		entry& e = sparse[entity_id & index_mask];
+		e.entity = entity_id;
+		e.component = handle;
+
+		if( owner )
+		{
+			owner->on_add( entity_id );
+		}
+
+		return handle;
+	}
+
+	bool has( id_type id )
+	{
+		return components.has( id );
+	}
+
+	t& lookup( id_type id )
+	{
+		return components.lookup( id );
+	}
+
+	void remove( id_type id )
+	{
+		if( owner )
+		{
+			owner->on_remove( components.read( id ).id );
+		}
+
+		entry& e = sparse[components.read( id ).id & index_mask];
+		log_removed( e.entity );
+		e.entity = index_mask;
+		e.component = index_mask;
+		components.remove( id );
+	}
+
+	//removes count components, the ids have to be valid and distinct
+	void remove_n( const id_type* ids, std::size_t count )
+	{
+		if( owner ) //the group has to hear about each of them
+		{
+			for( std::size_t c = 0; c < count; ++c )
+			{
+				remove( ids[c] );
+			}
+
+			return;
+		}
+
+		for( std::size_t c = 0; c < count; ++c )
+		{
+			entry& e = sparse[components.read( ids[c] ).id & index_mask];
+			log_removed( e.entity );
+			e.entity = index_mask;
+			e.component = index_mask;
+		}
+
+		components.remove_n( ids, count );
+	}
+
+	//rebuilds the entity index from the components, after they were restored
+	void rebuild_index()
+	{
+		sparse.clear();
+		for( auto c = components.begin(); c != components.end(); ++c )
+		{
+			if( ( c->second.id & index_mask ) >= sparse.size() )
+			{
+				sparse.resize( ( c->second.id & index_mask ) + 1 );
+			}
+
+			sparse[c->second.id & index_mask].entity = c->second.id;
+			sparse[c->second.id & index_mask].component = c->first;
+		}
+	}
+
+	bool has_for_entity( id_type entity_id )
+	{
+		return ( entity_id & index_mask ) < sparse.size() && sparse[entity_id & index_mask].entity == entity_id;
+	}
+
+	//only valid if has_for_entity() is true
+	id_type handle_for_entity( id_type entity_id )
+	{
+		return sparse[entity_id & index_mask].component;
+	}
+
+	//only valid if has_for_entity() is true
+	t& get_for_entity( id_type entity_id )
+	{
+		return components.lookup( sparse[entity_id & index_mask].component );
+	}
+
+	//position of the entity's component in the object buffer
+	//only valid if has_for_entity() is true
+	inner_id_type slot_for_entity( id_type entity_id )
+	{
+		return components.slot( sparse[entity_id & index_mask].component );
+	}
+
+	//moves the entity's component to the given position of the object buffer
+	void move_to( id_type entity_id, inner_id_type pos )
+	{
+		components.swap( slot_for_entity( entity_id ), pos );
+	}
+
+	//component at a position of the object buffer
+	t& at( inner_id_type pos )
+	{
+		return components.get_objects()[pos].second;
+	}
+
+	group_base* get_owner()
+	{
+		return owner;
+	}
+
+	void set_owner( group_base* g )
+	{
+		owner = g;
+	}
+
+	std::size_t size()
+	{
+		return components.get_objects().size();
+	}
+
+	object_manager< t >& get_data()
+	{
+		return components;
+	}
+
+	//change tracking, see object_manager
+	void enable_tracking()
+	{
+		components.enable_tracking();
+	}
+
+	std::uint32_t commit()
+	{
+		return components.commit();
+	}
+
+	//calls func( const change&, entity id ) for each component added, changed or removed
+	//after version since, the removed ones after the others
+	//an entity that lost its component and got a new one is only reported as added
+	template< class f >
+	void changes_since( std::uint32_t since, f func )
+	{
+		components.changes_since( since, [&]( const change& c )
+		{
+			if( c.kind != change::removed )
+			{
+				func( c, components.read( c.id ).id );
+			}
+		} );
+
+		std::size_t first = std::upper_bound( removed.begin(), removed.end(), since, []( std::uint32_t v, const change& c )
+		{
+			return v < c.version;
+		} ) - removed.begin();
+
+		for( std::size_t i = first; i < removed.size(); ++i )
+		{
+			change c = removed[i];
+			if( !has_for_entity( c.id ) )
+			{
+				func( c, c.id );
+			}
+		}
+	}
+
+	//readers register the last version they have seen, so the log is kept until all of them saw it
+	void add_reader( const std::uint32_t* seen )
+	{
+		readers.push_back( seen );
+	}
+
+	void remove_reader( const std::uint32_t* seen )
+	{
+		readers.erase( std::find( readers.begin(), readers.end(), seen ) );
+	}
+
+	//drops the changes every reader has seen
+	void forget_read()
+	{
+		if( readers.empty() )
+		{
+			return;
+		}
+
+		std::uint32_t until = *readers.front();
+		for( auto c = readers.begin(); c != readers.end(); ++c )
+		{
+			until = std::min( until, **c );
+		}
+
+		components.forget( until );
+
+		auto last = std::upper_bound( removed.begin(), removed.end(), until, []( std::uint32_t v, const change& c )
+		{
+			return v < c.version;
+		} );
+		removed.erase( removed.begin(), last );
+	}
+
+	iter begin()
+	{
+		return components.begin();
+	}
+
+	iter end()
+	{
+		return components.end();
+	}
+
+	component_store() : owner( 0 ) {}
+};
+
+}
+
+#endif
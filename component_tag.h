@@ -0,0 +1,128 @@
+#ifndef component_tag_h
+#define component_tag_h
+
+#include <vector>
+#include <type_traits>
+#include <cstdint>
+
+#include "object_manager.h"
+
+namespace om
+{
+
+/*
+ * Something that has to forget an entity when it goes away, so whoever removes
+ * entities can tell every tag set without knowing its type.
+ */
+class tag_base
+{
+public:
+	virtual void remove( id_type entity_id ) = 0;
+	virtual ~tag_base() {}
+};
+
+/*
+ * Tag components: markers like "static" or "selected" that carry no data.
+ *
+ * t is an empty struct that only names the tag (and can be declared in a system's
+ * access like any component). There is no component array, an entity only costs a
+ * bit in a bitset indexed by its index bits, so has() is a bit test, plus an entry in
+ * a packed list of the tagged entities, so they can be visited without scanning
+ * the bitset. The list holds full ids, so an id of an older generation isn't tagged.
+ *
+ * Still remove the tags of an entity when it is removed, or the tag takes up the
+ * index, and each() visits the dead id, until the next entity with that index is tagged.
+ */
+template< class t >
+class tag_store : public tag_base
+{
+private:
+	static_assert( std::is_empty< t >::value, "tags have no data" );
+
+	std::vector< std::uint64_t > bits; //indexed by entity index bits
+	std::vector< id_type > tagged; //the tagged entities, packed
+	std::vector< std::uint32_t > slots; //position in tagged, indexed by entity index bits
+
+	tag_store( const tag_store& );
+	tag_store& operator=( const tag_store& );
+
+	//only the index bits, no matter the generation
+	bool has_index( id_type i ) const
+	{
+		return i / 64 < bits.size() && ( bits[i / 64] >> ( i % 64 ) & 1 );
+	}
+protected:
+public:
+	bool has( id_type entity_id ) const
+	{
+		id_type i = entity_id & index_mask;
+		return has_index( i ) && tagged[slots[i]] == entity_id;
+	}
+
+	void add( id_type entity_id )
+	{
+		id_type i = entity_id & index_mask;
+		if( has_index( i ) )
+		{
+			tagged[slots[i]] = entity_id; //in case it was left over from an older generation
+			return;
+		}
+
+		if( i / 64 >= bits.size() )
+		{
+			bits.resize( i / 64 + 1, 0 );
+			slots.resize( bits.size() * 64 );
+		}
+
+		bits[i / 64] |= std::uint64_t( 1 ) << ( i % 64 );
+		slots[i] = std::uint32_t( tagged.size() );
+		tagged.push_back( entity_id );
+	}
+
+	void remove( id_type entity_id )
+	{
+		if( !has( entity_id ) )
+		{
+			return;
+		}
+
+		id_type i = entity_id & index_mask;
+		bits[i / 64] &= ~( std::uint64_t( 1 ) << ( i % 64 ) );
+
+		std::uint32_t s = slots[i];
+		tagged[s] = tagged.back();
+		tagged.pop_back();
+		if( s < tagged.size() )
+		{
+			slots[tagged[s] & index_mask] = s;
+		}
+	}
+
+	//calls func( entity id ) for each tagged entity, don't add or remove tags meanwhile
+	template< class f >
+	void each( f func )
+	{
+		for( auto c = tagged.begin(); c != tagged.end(); ++c )
+		{
+			func( *c );
+		}
+	}
+
+	std::size_t size() const
+	{
+		return tagged.size();
+	}
+
+	void clear()
+	{
+		bits.clear();
+		tagged.clear();
+		slots.clear();
+	}
+
+	tag_store() {}
+};
+
+}
+
+#endif
@@ -0,0 +1,204 @@
+#ifndef component_view_h
+#define component_view_h
+
+#include <tuple>
+#include <cstddef>
+#include <type_traits>
+
+#include "component_store.h"
+
+/*
+ * Joins over component stores by entity id.
+ *
+ * view:  iterates the smallest of the stores and looks the entity up in the others
+ *        through their reverse index. Nothing is stored, it can be made on the fly.
+ * group: owns its stores and keeps the components of matching entities packed at the
+ *        front of each store, in the same order, so the join is a linear walk over
+ *        the first size() elements of every store. A store can only be owned by one group.
+ *
+ * Both call func( entity_id, component&... ) in the order the stores were given.
+ */
+
+namespace om
+{
+
+template< class... s >
+class view
+{
+private:
+	typedef typename detail::gen_seq< sizeof...( s ) >::type store_seq;
+	std::tuple< s*... > stores;
+
+	template< std::size_t... n >
+	bool all_have( id_type entity_id, detail::seq< n... > )
+	{
+		bool r = true;
+		detail::expand( { ( r = r && std::get< n >( stores )->has_for_entity( entity_id ), 0 )... } );
+		return r;
+	}
+
+	template< class f, std::size_t... n >
+	void call( f& func, id_type entity_id, detail::seq< n... > )
+	{
+		func( entity_id, std::get< n >( stores )->get_for_entity( entity_id )... );
+	}
+
+	//walks the n-th store, and checks the others
+	template< std::size_t n, class f >
+	void each_from( f& func )
+	{
+		auto& lead = *std::get< n >( stores );
+		for( auto c = lead.begin(); c != lead.end(); ++c )
+		{
+			id_type entity_id = c->second.id;
+			if( all_have( entity_id, store_seq() ) )
+			{
+				call( func, entity_id, store_seq() );
+			}
+		}
+	}
+
+	template< class f >
+	void dispatch( std::size_t, f&, std::integral_constant< std::size_t, sizeof...( s ) > ) {}
+
+	template< class f, std::size_t n >
+	void dispatch( std::size_t lead, f& func, std::integral_constant< std::size_t, n > )
+	{
+		if( lead == n )
+		{
+			each_from< n >( func );
+		}
+		else
+		{
+			dispatch( lead, func, std::integral_constant< std::size_t, n + 1 >() );
+		}
+	}
+
+	template< std::size_t... n >
+	std::size_t smallest( detail::seq< n... > )
+	{
+		std::size_t sizes[] = { std::get< n >( stores )->size()... };
+		std::size_t lead = 0;
+		for( std::size_t c = 1; c < sizeof...( s ); ++c )
+		{
+			if( sizes[c] < sizes[lead] )
+			{
+				lead = c;
+			}
+		}
+		return lead;
+	}
+protected:
+public:
+	template< class f >
+	void each( f func )
+	{
+		dispatch( smallest( store_seq() ), func, std::integral_constant< std::size_t, 0 >() );
+	}
+
+	view( s&... st ) : stores( &st... ) {}
+};
+
+template< class... s >
+view< s... > make_view( s&... st )
+{
+	return view< s... >( st... );
+}
+
+template< class... s >
+class group : public group_base
+{
+private:
+	typedef typename detail::gen_seq< sizeof...( s ) >::type store_seq;
+	std::tuple< s*... > stores;
+	std::size_t count; //number of packed matches at the front of each store
+
+	group( const group& );
+	group& operator=( const group& );
+
+	template< std::size_t... n >
+	bool all_have( id_type entity_id, detail::seq< n... > )
+	{
+		bool r = true;
+		detail::expand( { ( r = r && std::get< n >( stores )->has_for_entity( entity_id ), 0 )... } );
+		return r;
+	}
+
+	template< std::size_t... n >
+	void move_all( id_type entity_id, inner_id_type pos, detail::seq< n... > )
+	{
+		detail::expand( { ( std::get< n >( stores )->move_to( entity_id, pos ), 0 )... } );
+	}
+
+	template< std::size_t... n >
+	void set_owner( group_base* g, detail::seq< n... > )
+	{
+		detail::expand( { ( std::get< n >( stores )->set_owner( g ), 0 )... } );
+	}
+
+	template< class f, std::size_t... n >
+	void call( f& func, inner_id_type pos, detail::seq< n... > )
+	{
+		func( std::get< 0 >( stores )->at( pos ).id, std::get< n >( stores )->at( pos )... );
+	}
+
+	bool contains( id_type entity_id )
+	{
+		return std::get< 0 >( stores )->has_for_entity( entity_id ) &&
+		       std::get< 0 >( stores )->slot_for_entity( entity_id ) < count;
+	}
+protected:
+public:
+	void on_add( id_type entity_id )
+	{
+		if( all_have( entity_id, store_seq() ) && !contains( entity_id ) )
+		{
+			move_all( entity_id, count, store_seq() );
+			++count;
+		}
+	}
+
+	void on_remove( id_type entity_id )
+	{
+		if( contains( entity_id ) )
+		{
+			--count;
+			move_all( entity_id, count, store_seq() );
+		}
+	}
+
+	std::size_t size()
+	{
+		return count;
+	}
+
+	template< class f >
+	void each( f func )
+	{
+		for( std::size_t c = 0; c < count; ++c )
+		{
+			call( func, c, store_seq() );
+		}
+	}
+
+	group( s&... st ) : stores( &st... ), count( 0 )
+	{
+		set_owner( this, store_seq() );
+
+		//pack whatever already matches
+		auto& first = *std::get< 0 >( stores );
+		for( std::size_t c = 0; c < first.size(); ++c )
+		{
+			on_add( first.at( c ).id );
+		}
+	}
+
+	~group()
+	{
+		set_owner( 0, store_seq() );
+	}
+};
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+#ifndef object_delta_h
+#define object_delta_h
+
+#include <vector>
+#include <unordered_map>
+#include <utility>
+#include <type_traits>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#include "object_manager.h"
+
+namespace om
+{
+
+/*
+ * Delta streams, to keep a copy of an object manager up to date somewhere else.
+ *
+ * The sender enables tracking on its manager, and every tick writes the changes
+ * made since the version the receiver last got, then commits:
+ *
+ *   write_delta( store, sent, buffer );
+ *   sent = store.commit();
+ *
+ * A stream is a small header, then one record per added, changed or removed object:
+ * the change kind, the sender's id, and the object's current data unless removed.
+ * Its size only depends on how much changed, not on how big the store is.
+ *
+ * The receiver keeps a remote id -> local id map, because the objects get new ids in
+ * the receiving manager. Data that refers to other objects (like a component's entity
+ * id) has to be translated by the caller, with get_local() of that object's receiver.
+ */
+struct delta_header
+{
+	std::uint32_t since; //the stream has the changes after this version
+	std::uint32_t version; //up to and including this one
+	std::uint32_t count; //number of records
+	std::uint32_t record_size; //size of an object's data
+	std::uint32_t id_size; //size of an id, depends on the handle policy
+};
+
+namespace detail
+{
+	template< class t >
+	void put( std::vector< unsigned char >& out, const t& d )
+	{
+		std::size_t at = out.size();
+		out.resize( at + sizeof( t ) );
+		std::memcpy( &out[at], &d, sizeof( t ) );
+	}
+
+	template< class t >
+	bool take( const unsigned char*& at, const unsigned char* end, t& d )
+	{
+		if( std::size_t( end - at ) < sizeof( t ) )
+		{
+			return false;
+		}
+
+		std::memcpy( &d, at, sizeof( t ) );
+		at += sizeof( t );
+		return true;
+	}
+}
+
+//appends the changes of store after version since to out, as convert( object ) records
+//convert has to return a trivially copyable type
+template< class r, class t, class p, class f >
+void write_delta_as( object_manager< t, p >& store, std::uint32_t since, std::vector< unsigned char >& out, f convert )
+{
+	static_assert( std::is_trivially_copyable< r >::value, "records have to be trivially copyable" );
+
+	std::size_t start = out.size();
+	delta_header h = { since, store.get_version(), 0, sizeof( r ), sizeof( typename p::id_type ) };
+	detail::put( out, h );
+
+	store.changes_since( since, [&]( const change& c )
+	{
+		detail::put( out, static_cast< std::uint8_t >( c.kind ) );
+		detail::put( out, static_cast< typename p::id_type >( c.id ) );
+		if( c.kind != change::removed )
+		{
+			detail::put( out, convert( store.read( c.id ) ) );
+		}
+		++h.count;
+	} );
+
+	std::memcpy( &out[start], &h, sizeof( h ) );
+}
+
+//appends the changes of store after version since to out
+template< class t, class p >
+void write_delta( object_manager< t, p >& store, std::uint32_t since, std::vector< unsigned char >& out )
+{
+	write_delta_as< t >( store, since, out, []( const t& d ) -> const t& { return d; } );
+}
+
+template< class t, class p = default_handle >
+class delta_receiver
+{
+public:
+	typedef typename p::id_type id_type;
+private:
+	std::unordered_map< id_type, id_type > remote_to_local;
+	std::uint32_t version;
+
+	delta_receiver( const delta_receiver& );
+	delta_receiver& operator=( const delta_receiver& );
+protected:
+public:
+	//applies a stream made by write_delta_as(), restore( record ) gives back the object
+	//returns false if the stream is malformed, the records before the problem stay applied
+	template< class r, class f >
+	bool apply_as( const unsigned char* data, std::size_t size, object_manager< t, p >& store, f restore )
+	{
+		const unsigned char* at = data;
+		const unsigned char* end = data + size;
+
+		delta_header h;
+		if( !detail::take( at, end, h ) || h.record_size != sizeof( r ) || h.id_size != sizeof( id_type ) )
+		{
+			return false;
+		}
+
+		for( std::uint32_t c = 0; c < h.count; ++c )
+		{
+			std::uint8_t kind;
+			id_type remote;
+			if( !detail::take( at, end, kind ) || !detail::take( at, end, remote ) )
+			{
+				return false;
+			}
+
+			auto it = remote_to_local.find( remote );
+
+			if( kind == change::removed )
+			{
+				if( it != remote_to_local.end() )
+				{
+					if( store.has( it->second ) )
+					{
+						store.remove( it->second );
+					}
+					remote_to_local.erase( it );
+				}
+				continue;
+			}
+
+			r record;
+			if( !detail::take( at, end, record ) )
+			{
+				return false;
+			}
+
+			//changes of objects we never saw are taken as adds, so a receiver can join late
+			if( it != remote_to_local.end() && store.has( it->second ) )
+			{
+				store.lookup( it->second ) = restore( record );
+			}
+			else
+			{
+				remote_to_local[remote] = store.add( restore( record ) );
+			}
+		}
+
+		version = h.version;
+		return true;
+	}
+
+	bool apply( const unsigned char* data, std::size_t size, object_manager< t, p >& store )
+	{
+		static_assert( std::is_trivially_copyable< t >::value, "use apply_as() for types that are not trivially copyable" );
+		return apply_as< t >( data, size, store, []( const t& d ) -> const t& { return d; } );
+	}
+
+	bool apply( const std::vector< unsigned char >& stream, object_manager< t, p >& store )
+	{
+		return apply( stream.data(), stream.size(), store );
+	}
+
+	//the local id of a sender's object, index_mask if it isn't known here
+	id_type get_local( id_type remote )
+	{
+		auto it = remote_to_local.find( remote );
+		return it == remote_to_local.end() ? p::index_mask : it->second;
+	}
+
+	//the last version that was applied
+	std::uint32_t get_version()
+	{
+		return version;
+	}
+
+	delta_receiver() : version( 0 ) {}
+};
+
+}
+
+#endif
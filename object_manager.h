@@ -1,143 +1,500 @@
-#ifndef object_manager_h
-#define object_manager_h
-
-#include <vector>
-
-template< class t >
-static void writeout_bits( t id )
-{
-  using namespace std;
-  om::id_type siz = sizeof( t ) * 8;
-  om::id_type one = 1;
-
-  cout << id << ": ";
-
-  for( om::id_type c = 0; c < siz; ++c )
-  {
-    cout << ( id & ( one << ( siz - 1 - c ) ) ? 1 : 0 );
-  }
-
-  cout << endl;
-}
-
-namespace om
-{
-
-/**/
-//64 bit IDs
-#define INDEX_MASK 0xffffffff
-#define INNER_MASK UINT_MAX
-#define NEW_OBJECT_ID_ADD 0x100000000
-typedef unsigned long long int id_type;
-typedef unsigned long int inner_id_type;
-/**/
-
-/**
-//32 bit IDs 
-#define INDEX_MASK 0xffff
-#define INNER_MASK USHRT_MAX
-#define NEW_OBJECT_ID_ADD 0x10000
-typedef unsigned long int id_type;
-typedef unsigned short int inner_id_type;
-/**/
-
-//32 + 16 + 16 bits
-//OR
-//64 + 32 + 32 bits
-struct index
-{
-	id_type id; //unique object identifier
-	inner_id_type idx; //index to the object buffer
-	inner_id_type next; //next free index
-	index( id_type i = INDEX_MASK, inner_id_type n = INDEX_MASK, inner_id_type ix = INDEX_MASK ) :
-		id( i ), idx( ix ), next( n ) {}
-};
-
-template< class t >
-class object_manager
-{
-private:
-	typedef std::pair< id_type, t > stored_type;
-	std::vector< stored_type > objects;
-	std::vector< index > indices;
-	inner_id_type freelist_enqueue;
-	inner_id_type freelist_dequeue;
-protected:
-public:
-  typedef typename std::vector< stored_type >::iterator iter;
-
-	bool has( id_type id )
-	{
-		index& in = indices[id & INDEX_MASK];
-		return in.id == id && in.idx != INNER_MASK;
-	}
-
-	t& lookup( id_type id )
-	{
-		return objects[indices[id & INDEX_MASK].idx].second;
-	}
-
-	id_type add( const t& d )
-	{
-		//no indices stored, or no space left for more indices
-		if( freelist_dequeue == INNER_MASK || freelist_dequeue == indices.size() )
-		{
-			freelist_dequeue = indices.size();
-			indices.push_back( index( indices.size(), indices.size() + 1 ) );
-		}
-
-		index& in = indices[freelist_dequeue];
-		freelist_dequeue = in.next;
-		in.id += NEW_OBJECT_ID_ADD;
-		in.idx = objects.size();
-		objects.push_back( stored_type( 0, d ) );
-		stored_type& o = objects[in.idx];
-		o.first = in.id;
-		return in.id;
-	}
-
-	void remove( id_type id )
-	{
-		index& in = indices[id & INDEX_MASK];
-
-		stored_type& o = objects[in.idx];
-		o = objects[objects.size() - 1];
-		indices[o.first & INDEX_MASK].idx = in.idx;
-		objects.resize( objects.size() - 1 );
-		in.idx = INNER_MASK;
-
-		//no indices stored, or no space left for more indices
-		if( freelist_enqueue == INNER_MASK || freelist_enqueue == indices.size() )
-		{
-			freelist_enqueue = indices.size() - 1;
-		}
-
-		indices[freelist_enqueue].next = id & INDEX_MASK;
-		freelist_enqueue = id & INDEX_MASK;
-	}
-
-	std::vector< stored_type >& get_objects()
-	{
-		return objects;
-	}
-
-  iter begin()
-  {
-    return objects.begin();
-  }
-
-  iter end()
-  {
-    return objects.end();
-  }
-
-	object_manager()
-	{
-		freelist_enqueue = INNER_MASK;
-		freelist_dequeue = INNER_MASK;
-	}
-};
-
-}
-
+#ifndef object_manager_h
+#define object_manager_h
+
+#include <vector>
+#include <cstddef>
+#include <initializer_list>
+#include <utility>
+#include <algorithm>
+#include <cstdint>
+#include <climits>
+#include <iostream>
+#include <cassert>
+
+namespace om
+{
+
+namespace detail
+{
+	//compile time index sequence, for walking tuples
+	template< std::size_t... n >
+	struct seq {};
+
+	template< std::size_t n, std::size_t... s >
+	struct gen_seq : gen_seq< n - 1, n - 1, s... > {};
+
+	template< std::size_t... s >
+	struct gen_seq< 0, s... >
+	{
+		typedef seq< s... > type;
+	};
+
+	//used to expand a parameter pack into a sequence of statements
+	inline void expand( std::initializer_list< int > ) {}
+}
+
+/*
+ * Handle policies, picked per object manager.
+ * An id is index_bits of index into the index buffer, and generation_bits of
+ * generation above it, which changes each time the index is reused, so old ids of
+ * a reused index don't match anymore. inner_id_type has to hold any index, its
+ * largest value means "no index", so that one is never handed out, which leaves
+ * one object less than the index bits could address.
+ */
+template< class id, class inner, unsigned index_bit_count, unsigned generation_bit_count >
+struct handle_policy
+{
+	typedef id id_type;
+	typedef inner inner_id_type;
+
+	static constexpr unsigned index_bits = index_bit_count;
+	static constexpr unsigned generation_bits = generation_bit_count;
+
+	static_assert( index_bits + generation_bits <= sizeof( id_type ) * 8, "the id type is too small" );
+	static_assert( index_bits <= sizeof( inner_id_type ) * 8, "the inner id type is too small" );
+
+	static constexpr id_type index_mask = ( id_type( 1 ) << index_bits ) - 1;
+	static constexpr id_type generation_add = id_type( 1 ) << index_bits; //added to the id when its index is reused
+	static constexpr id_type id_mask = index_bits + generation_bits == sizeof( id_type ) * 8 ? id_type( ~id_type( 0 ) ) : ( id_type( 1 ) << ( index_bits + generation_bits ) ) - 1;
+	static constexpr inner_id_type inner_mask = inner_id_type( ~inner_id_type( 0 ) );
+};
+
+template< class id, class inner, unsigned i, unsigned g >
+constexpr id handle_policy< id, inner, i, g >::index_mask;
+template< class id, class inner, unsigned i, unsigned g >
+constexpr id handle_policy< id, inner, i, g >::generation_add;
+template< class id, class inner, unsigned i, unsigned g >
+constexpr id handle_policy< id, inner, i, g >::id_mask;
+template< class id, class inner, unsigned i, unsigned g >
+constexpr inner handle_policy< id, inner, i, g >::inner_mask;
+
+//64 bit ids, 32 + 32 bit index entries, up to 4G - 1 objects
+typedef handle_policy< unsigned long long int, std::uint32_t, 32, 32 > handle_64;
+
+//32 bit ids, 16 + 16 bit index entries, up to 64K - 1 objects
+typedef handle_policy< std::uint32_t, std::uint16_t, 16, 16 > handle_32;
+
+//what everything uses unless it picks something else
+typedef handle_64 default_handle;
+typedef default_handle::id_type id_type;
+typedef default_handle::inner_id_type inner_id_type;
+const id_type index_mask = default_handle::index_mask; //also used as "no object"
+const inner_id_type inner_mask = default_handle::inner_mask;
+
+//32 + 16 + 16 bits
+//OR
+//64 + 32 + 32 bits
+template< class h >
+struct basic_index
+{
+	typename h::id_type id; //unique object identifier
+	typename h::inner_id_type idx; //index to the object buffer
+	typename h::inner_id_type next; //next free index
+	basic_index( typename h::id_type i = h::index_mask, typename h::inner_id_type n = h::inner_mask, typename h::inner_id_type ix = h::inner_mask ) :
+		id( i ), idx( ix ), next( n ) {}
+};
+
+typedef basic_index< default_handle > index;
+
+//an entry of an object manager's change log
+struct change
+{
+	enum kind_type
+	{
+		added, changed, removed
+	};
+
+	id_type id; //wide enough for the ids of every handle policy
+	std::uint32_t version; //version the change was made in
+	std::uint32_t kind;
+};
+
+template< class t, class h = default_handle >
+class object_manager
+{
+public:
+	typedef h handle_type;
+	typedef typename h::id_type id_type;
+	typedef typename h::inner_id_type inner_id_type;
+	typedef basic_index< h > index;
+private:
+	typedef std::pair< id_type, t > stored_type;
+	std::vector< stored_type > objects;
+	std::vector< index > indices;
+	inner_id_type freelist_enqueue; //last free index, inner_mask if there is none
+	inner_id_type freelist_dequeue; //first free index, inner_mask if there is none
+
+	//change tracking, off unless enable_tracking() was called
+	bool tracking;
+	std::uint32_t version; //changes made now are logged with this version
+	std::vector< std::uint32_t > versions; //per index, the version it was last logged in
+	std::vector< std::uint32_t > created; //per index, the version its object was added in
+	std::vector< change > changes; //ordered by version
+
+	//logs a change, at most once per object and version
+	void log( id_type id, change::kind_type kind )
+	{
+		inner_id_type i = id & h::index_mask;
+		if( i >= versions.size() )
+		{
+			versions.resize( i + 1, 0 );
+			created.resize( i + 1, 0 );
+		}
+		else if( versions[i] == version && kind == change::changed )
+		{
+			return;
+		}
+
+		versions[i] = version;
+		if( kind == change::added )
+		{
+			created[i] = version;
+		}
+		change c = { id, version, static_cast< std::uint32_t >( kind ) };
+		changes.push_back( c );
+	}
+
+	//takes the oldest free index, or makes a new one
+	index& take_index()
+	{
+		if( freelist_dequeue == h::inner_mask )
+		{
+			//inner_mask marks free and dead entries, it can't be an index too
+			assert( indices.size() < std::size_t( h::inner_mask ) && "out of indices, use a wider handle policy" );
+			indices.push_back( index( indices.size() ) );
+			return indices.back();
+		}
+
+		index& in = indices[freelist_dequeue];
+		freelist_dequeue = in.next;
+
+		if( freelist_dequeue == h::inner_mask )
+		{
+			freelist_enqueue = h::inner_mask;
+		}
+
+		return in;
+	}
+
+	//queues an index for reuse
+	void free_index( inner_id_type i )
+	{
+		indices[i].idx = h::inner_mask;
+		indices[i].next = h::inner_mask;
+
+		if( freelist_enqueue == h::inner_mask )
+		{
+			freelist_dequeue = i;
+		}
+		else
+		{
+			indices[freelist_enqueue].next = i;
+		}
+
+		freelist_enqueue = i;
+	}
+protected:
+public:
+  typedef typename std::vector< stored_type >::iterator iter;
+
+	bool has( id_type id )
+	{
+		index& in = indices[id & h::index_mask];
+		return in.id == id && in.idx != h::inner_mask;
+	}
+
+	//mutable access, counts as a change when tracking
+	t& lookup( id_type id )
+	{
+		if( tracking )
+		{
+			log( id, change::changed );
+		}
+
+		return objects[indices[id & h::index_mask].idx].second;
+	}
+
+	//read only access, never counts as a change
+	const t& read( id_type id )
+	{
+		return objects[indices[id & h::index_mask].idx].second;
+	}
+
+	//marks an object changed that was written without lookup(), eg. while iterating
+	void touch( id_type id )
+	{
+		if( tracking )
+		{
+			log( id, change::changed );
+		}
+	}
+
+	id_type add( const t& d )
+	{
+		index& in = take_index();
+		in.id = ( in.id + h::generation_add ) & h::id_mask;
+		in.idx = objects.size();
+		objects.push_back( stored_type( in.id, d ) );
+
+		if( tracking )
+		{
+			log( in.id, change::added );
+		}
+
+		return in.id;
+	}
+
+	//adds count copies of d, and writes their ids to out
+	void add_n( std::size_t count, const t& d, id_type* out )
+	{
+		objects.reserve( objects.size() + count );
+		indices.reserve( indices.size() + count );
+
+		for( std::size_t c = 0; c < count; ++c )
+		{
+			index& in = take_index();
+			in.id = ( in.id + h::generation_add ) & h::id_mask;
+			in.idx = objects.size();
+			objects.push_back( stored_type( in.id, d ) );
+			out[c] = in.id;
+
+			if( tracking )
+			{
+				log( in.id, change::added );
+			}
+		}
+	}
+
+	void remove( id_type id )
+	{
+		index& in = indices[id & h::index_mask];
+
+		stored_type& o = objects[in.idx];
+		o = objects[objects.size() - 1];
+		indices[o.first & h::index_mask].idx = in.idx;
+		objects.pop_back();
+
+		free_index( id & h::index_mask );
+
+		if( tracking )
+		{
+			log( id, change::removed );
+		}
+	}
+
+	//removes count objects, the ids have to be valid and distinct
+	//the survivors from the end fill the holes in order, so each of them is moved at most once
+	void remove_n( const id_type* ids, std::size_t count )
+	{
+		std::vector< inner_id_type > holes( count );
+		for( std::size_t c = 0; c < count; ++c )
+		{
+			holes[c] = indices[ids[c] & h::index_mask].idx;
+			free_index( ids[c] & h::index_mask );
+
+			if( tracking )
+			{
+				log( ids[c], change::removed );
+			}
+		}
+
+		std::sort( holes.begin(), holes.end() );
+
+		inner_id_type new_size = objects.size() - count;
+		std::size_t hole = 0; //next hole to fill
+		std::size_t removed = std::lower_bound( holes.begin(), holes.end(), new_size ) - holes.begin(); //first removed object in the tail
+
+		for( inner_id_type src = new_size; src < objects.size() && hole < holes.size() && holes[hole] < new_size; ++src )
+		{
+			if( removed < holes.size() && holes[removed] == src )
+			{
+				++removed; //removed as well, nothing to move
+				continue;
+			}
+
+			objects[holes[hole]] = std::move( objects[src] );
+			indices[objects[holes[hole]].first & h::index_mask].idx = holes[hole];
+			++hole;
+		}
+
+		objects.erase( objects.begin() + new_size, objects.end() );
+	}
+
+	//position of the object in the object buffer
+	inner_id_type slot( id_type id )
+	{
+		return indices[id & h::index_mask].idx;
+	}
+
+	//exchanges the objects at two positions of the object buffer, handles stay valid
+	void swap( inner_id_type a, inner_id_type b )
+	{
+		if( a == b )
+		{
+			return;
+		}
+
+		std::swap( objects[a], objects[b] );
+		indices[objects[a].first & h::index_mask].idx = a;
+		indices[objects[b].first & h::index_mask].idx = b;
+	}
+
+	//moves the object at position order[c] to position c, for every c, handles stay valid
+	//order has to be a permutation of the positions
+	void reorder( const std::vector< std::size_t >& order )
+	{
+		std::vector< stored_type > sorted;
+		sorted.reserve( objects.size() );
+		for( auto c = order.begin(); c != order.end(); ++c )
+		{
+			sorted.push_back( std::move( objects[*c] ) );
+		}
+		objects.swap( sorted );
+
+		for( std::size_t c = 0; c < objects.size(); ++c )
+		{
+			indices[objects[c].first & h::index_mask].idx = inner_id_type( c );
+		}
+	}
+
+	std::vector< stored_type >& get_objects()
+	{
+		return objects;
+	}
+
+	std::vector< index >& get_indices()
+	{
+		return indices;
+	}
+
+	void get_freelist( inner_id_type& enqueue, inner_id_type& dequeue )
+	{
+		enqueue = freelist_enqueue;
+		dequeue = freelist_dequeue;
+	}
+
+	//only for restoring a saved state, together with the indices and objects
+	void set_freelist( inner_id_type enqueue, inner_id_type dequeue )
+	{
+		freelist_enqueue = enqueue;
+		freelist_dequeue = dequeue;
+	}
+
+	//starts logging adds, changes and removes, see changes_since()
+	void enable_tracking()
+	{
+		if( tracking )
+		{
+			return;
+		}
+
+		tracking = true;
+		versions.assign( indices.size(), 0 );
+		created.assign( indices.size(), 0 );
+	}
+
+	void disable_tracking()
+	{
+		tracking = false;
+		versions.clear();
+		created.clear();
+		changes.clear();
+	}
+
+	bool is_tracking()
+	{
+		return tracking;
+	}
+
+	//the version changes are logged with right now
+	std::uint32_t get_version()
+	{
+		return version;
+	}
+
+	//closes the current version and returns it, later changes get a newer one
+	std::uint32_t commit()
+	{
+		return version++;
+	}
+
+	//calls func( const change& ) for each change made after version since, oldest first
+	//an object is reported once, with its latest change, its add or its remove
+	template< class f >
+	void changes_since( std::uint32_t since, f func )
+	{
+		std::size_t first = std::upper_bound( changes.begin(), changes.end(), since, []( std::uint32_t v, const change& c )
+		{
+			return v < c.version;
+		} ) - changes.begin();
+
+		//by position, func may log new changes
+		for( std::size_t i = first; i < changes.size(); ++i )
+		{
+			change c = changes[i];
+
+			if( c.kind == change::removed )
+			{
+				func( c );
+			}
+			else if( has( c.id ) && versions[c.id & h::index_mask] == c.version )
+			{
+				//an object added and then changed is still reported as added
+				if( c.kind == change::changed && created[c.id & h::index_mask] > since )
+				{
+					c.kind = change::added;
+				}
+
+				func( c );
+			}
+		}
+	}
+
+	//drops the log up to and including version, once nobody asks for those changes anymore
+	void forget( std::uint32_t until )
+	{
+		auto last = std::upper_bound( changes.begin(), changes.end(), until, []( std::uint32_t v, const change& c )
+		{
+			return v < c.version;
+		} );
+
+		changes.erase( changes.begin(), last );
+	}
+
+  iter begin()
+  {
+    return objects.begin();
+  }
+
+  iter end()
+  {
+    return objects.end();
+  }
+
+	object_manager() : tracking( false ), version( 1 )
+	{
+		freelist_enqueue = h::inner_mask;
+		freelist_dequeue = h::inner_mask;
+	}
+};
+
+}
+
+template< class t >
+static void writeout_bits( t id )
+{
+  using namespace std;
+  om::id_type siz = sizeof( t ) * 8;
+  om::id_type one = 1;
+
+  cout << id << ": ";
+
+  for( om::id_type c = 0; c < siz; ++c )
+  {
+    cout << ( id & ( one << ( siz - 1 - c ) ) ? 1 : 0 );
+  }
+
+  cout << endl;
+}
+
 #endif
\ No newline at end of file
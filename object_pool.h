@@ -0,0 +1,180 @@
+#ifndef object_pool_h
+#define object_pool_h
+
+#include <vector>
+#include <algorithm>
+#include <new>
+#include <utility>
+#include <cstddef>
+#include <type_traits>
+
+namespace om
+{
+
+/*
+ * Common interface of the pools that hand out objects derived from b, so an object
+ * can be given back without knowing its exact type, and every pool can be emptied at once.
+ */
+template< class b >
+class pool_base
+{
+	static std::vector< pool_base* >& pools()
+	{
+		static std::vector< pool_base* > instance;
+		return instance;
+	}
+protected:
+	pool_base()
+	{
+		pools().push_back( this );
+	}
+public:
+	virtual void release( b* p ) = 0;
+	virtual void release_all() = 0;
+
+	//destroys every object of every pool of this family
+	static void release_all_pools()
+	{
+		for( auto c = pools().begin(); c != pools().end(); ++c )
+		{
+			( *c )->release_all();
+		}
+	}
+
+	virtual ~pool_base()
+	{
+		pools().erase( std::find( pools().begin(), pools().end(), this ) );
+	}
+};
+
+/*
+ * Hands out t's from large contiguous blocks.
+ * New objects are taken from the free list first, then from the end of the last block,
+ * so objects created together sit next to each other. Freed slots go on the free list,
+ * malloc is only touched when a new block is needed.
+ */
+template< class t, class b = t >
+class pool : public pool_base< b >
+{
+private:
+	struct slot
+	{
+		union
+		{
+			slot* next; //while on the free list
+			typename std::aligned_storage< sizeof( t ), std::alignment_of< t >::value >::type data;
+		};
+		bool live; //kept in the slot, so creating and destroying needn't find the block
+	};
+
+	static const std::size_t block_bytes = 64 * 1024;
+	static const std::size_t block_size = sizeof( slot ) < block_bytes ? block_bytes / sizeof( slot ) : 1; //objects per block
+
+	std::vector< slot* > blocks;
+	slot* freelist;
+	std::size_t used; //slots taken from the last block so far
+	std::size_t count; //live objects
+
+	pool( const pool& );
+	pool& operator=( const pool& );
+
+	slot* allocate()
+	{
+		if( freelist )
+		{
+			slot* s = freelist;
+			freelist = s->next;
+			return s;
+		}
+
+		if( blocks.empty() || used == block_size )
+		{
+			blocks.push_back( new slot[block_size]() ); //not live
+			used = 0;
+		}
+
+		return blocks.back() + used++;
+	}
+protected:
+public:
+	template< class... a >
+	t* create( a&&... args )
+	{
+		slot* s = allocate();
+		t* p = new( &s->data ) t( std::forward< a >( args )... );
+		s->live = true;
+		++count;
+		return p;
+	}
+
+	void destroy( t* p )
+	{
+		slot* s = reinterpret_cast< slot* >( p );
+		p->~t();
+		s->live = false;
+		s->next = freelist;
+		freelist = s;
+		--count;
+	}
+
+	void release( b* p )
+	{
+		destroy( static_cast< t* >( p ) );
+	}
+
+	//destroys every object and gives the blocks back in one go
+	void release_all()
+	{
+		for( auto c = blocks.begin(); c != blocks.end(); ++c )
+		{
+			std::size_t n = c + 1 == blocks.end() ? used : block_size;
+			for( std::size_t d = 0; d < n; ++d )
+			{
+				if( ( *c )[d].live )
+				{
+					reinterpret_cast< t* >( &( *c )[d].data )->~t();
+				}
+			}
+
+			delete [] *c;
+		}
+
+		blocks.clear();
+		freelist = 0;
+		used = 0;
+		count = 0;
+	}
+
+	//visits the live objects in memory order
+	template< class f >
+	void each( f func )
+	{
+		for( auto c = blocks.begin(); c != blocks.end(); ++c )
+		{
+			std::size_t n = c + 1 == blocks.end() ? used : block_size;
+			for( std::size_t d = 0; d < n; ++d )
+			{
+				if( ( *c )[d].live )
+				{
+					func( *reinterpret_cast< t* >( &( *c )[d].data ) );
+				}
+			}
+		}
+	}
+
+	std::size_t size()
+	{
+		return count;
+	}
+
+	pool() : freelist( 0 ), used( 0 ), count( 0 ) {}
+
+	~pool()
+	{
+		release_all();
+	}
+};
+
+}
+
+#endif
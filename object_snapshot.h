@@ -0,0 +1,620 @@
+#ifndef object_snapshot_h
+#define object_snapshot_h
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <type_traits>
+#include <cstdio>
+#include <cstring>
+#include <cstddef>
+#include <cstdint>
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#include "object_manager.h"
+
+namespace om
+{
+
+/*
+ * Binary snapshot of object managers.
+ *
+ * The file is a header, then the arrays of each saved manager, then a string table
+ * and a table of sections at the end. A section holds the indices and objects arrays
+ * of one manager exactly as they are in memory, plus its freelist, so loading is one
+ * copy per array and handles saved before stay valid after.
+ * Every array starts on a 64 byte boundary, so a mapped file can be read in place.
+ *
+ * Only trivially copyable types can be written as they are. Anything else (like
+ * strings) is written through write_as() as a trivially copyable record, strings
+ * go to the string table with add_string() and are stored as their number.
+ *
+ * The header records the byte order and each section the sizes of its ids and
+ * index entries, files written by a different build are rejected instead of misread.
+ */
+const std::uint32_t snapshot_version = 2;
+const std::uint32_t snapshot_byte_order = 0x01020304;
+const std::size_t snapshot_alignment = 64;
+
+struct snapshot_header
+{
+	char magic[8]; //"OMSNAP"
+	std::uint32_t version;
+	std::uint32_t byte_order;
+	std::uint32_t section_count;
+	std::uint32_t reserved;
+	std::uint64_t sections_offset;
+	std::uint64_t strings_offset; //string count, then count + 1 offsets, then the characters
+};
+
+struct snapshot_section
+{
+	std::uint32_t tag; //chosen by the caller, one per manager
+	std::uint32_t object_size; //size of one stored object, with its id
+	std::uint32_t id_size; //these two depend on the manager's handle policy
+	std::uint32_t index_size;
+	std::uint64_t object_count;
+	std::uint64_t objects_offset;
+	std::uint64_t index_count;
+	std::uint64_t indices_offset;
+	std::uint64_t freelist_enqueue;
+	std::uint64_t freelist_dequeue;
+};
+
+class snapshot_writer
+{
+private:
+	std::FILE* file;
+	std::uint64_t offset;
+	std::vector< snapshot_section > sections;
+	std::vector< std::string > strings;
+	std::unordered_map< std::string, std::uint32_t > string_ids;
+
+	snapshot_writer( const snapshot_writer& );
+	snapshot_writer& operator=( const snapshot_writer& );
+
+	void put( const void* data, std::size_t size )
+	{
+		std::fwrite( data, 1, size, file );
+		offset += size;
+	}
+
+	void align()
+	{
+		static const char zeros[snapshot_alignment] = {};
+		put( zeros, ( snapshot_alignment - offset % snapshot_alignment ) % snapshot_alignment );
+	}
+
+	template< class t, class p >
+	snapshot_section begin_section( std::uint32_t tag, object_manager< t, p >& store )
+	{
+		snapshot_section s = {};
+		s.tag = tag;
+		s.object_size = sizeof( std::pair< typename p::id_type, t > );
+		s.id_size = sizeof( typename p::id_type );
+		s.index_size = sizeof( typename object_manager< t, p >::index );
+		s.object_count = store.get_objects().size();
+		s.index_count = store.get_indices().size();
+
+		typename p::inner_id_type enqueue, dequeue;
+		store.get_freelist( enqueue, dequeue );
+		s.freelist_enqueue = enqueue;
+		s.freelist_dequeue = dequeue;
+
+		align();
+		s.indices_offset = offset;
+		put( store.get_indices().data(), store.get_indices().size() * s.index_size );
+
+		align();
+		s.objects_offset = offset;
+		return s;
+	}
+protected:
+public:
+	bool open( const char* path )
+	{
+		file = std::fopen( path, "wb" );
+		if( !file )
+		{
+			return false;
+		}
+
+		snapshot_header h = {}; //filled in by close()
+		offset = 0;
+		put( &h, sizeof( h ) );
+		return true;
+	}
+
+	//writes the manager's arrays as they are
+	template< class t, class p >
+	void write( std::uint32_t tag, object_manager< t, p >& store )
+	{
+		static_assert( std::is_trivially_copyable< t >::value, "use write_as() for types that are not trivially copyable" );
+
+		snapshot_section s = begin_section( tag, store );
+		put( store.get_objects().data(), store.get_objects().size() * s.object_size );
+		sections.push_back( s );
+	}
+
+	//writes convert( object ) for each object, convert returns a trivially copyable record
+	template< class r, class t, class p, class f >
+	void write_as( std::uint32_t tag, object_manager< t, p >& store, f convert )
+	{
+		static_assert( std::is_trivially_copyable< r >::value, "records have to be trivially copyable" );
+
+		snapshot_section s = begin_section( tag, store );
+		s.object_size = sizeof( std::pair< typename p::id_type, r > );
+
+		auto& objects = store.get_objects();
+		for( auto c = objects.begin(); c != objects.end(); ++c )
+		{
+			std::pair< typename p::id_type, r > record( c->first, convert( c->second ) );
+			put( &record, sizeof( record ) );
+		}
+
+		sections.push_back( s );
+	}
+
+	//returns the string's number in the string table, equal strings share one
+	std::uint32_t add_string( const std::string& str )
+	{
+		auto it = string_ids.find( str );
+		if( it != string_ids.end() )
+		{
+			return it->second;
+		}
+
+		std::uint32_t id = static_cast< std::uint32_t >( strings.size() );
+		strings.push_back( str );
+		string_ids[str] = id;
+		return id;
+	}
+
+	//writes the string table and the sections, returns false if anything failed
+	bool close()
+	{
+		if( !file )
+		{
+			return false;
+		}
+
+		snapshot_header h = {};
+		std::memcpy( h.magic, "OMSNAP\0\0", 8 );
+		h.version = snapshot_version;
+		h.byte_order = snapshot_byte_order;
+		h.section_count = static_cast< std::uint32_t >( sections.size() );
+
+		align();
+		h.strings_offset = offset;
+		std::uint64_t count = strings.size();
+		put( &count, sizeof( count ) );
+		std::uint64_t start = 0;
+		for( auto c = strings.begin(); c != strings.end(); ++c )
+		{
+			put( &start, sizeof( start ) );
+			start += c->size() + 1;
+		}
+		put( &start, sizeof( start ) );
+		for( auto c = strings.begin(); c != strings.end(); ++c )
+		{
+			put( c->c_str(), c->size() + 1 );
+		}
+
+		align();
+		h.sections_offset = offset;
+		put( sections.data(), sections.size() * sizeof( snapshot_section ) );
+
+		std::fseek( file, 0, SEEK_SET );
+		std::fwrite( &h, 1, sizeof( h ), file );
+
+		bool ok = !std::ferror( file );
+		ok = std::fclose( file ) == 0 && ok;
+		file = 0;
+		sections.clear();
+		strings.clear();
+		string_ids.clear();
+		return ok;
+	}
+
+	snapshot_writer() : file( 0 ), offset( 0 ) {}
+
+	~snapshot_writer()
+	{
+		if( file )
+		{
+			close();
+		}
+	}
+};
+
+/*
+ * Read only view of a saved manager, straight on top of the mapped file.
+ * Valid as long as the snapshot stays open.
+ */
+template< class t, class p = default_handle >
+class mapped_store
+{
+public:
+	typedef typename p::id_type id_type;
+	typedef basic_index< p > index;
+private:
+	typedef std::pair< id_type, t > stored_type;
+
+	const stored_type* objects;
+	const index* indices;
+	std::size_t object_count;
+	std::size_t index_count;
+protected:
+public:
+	typedef const stored_type* iter;
+
+	bool valid()
+	{
+		return objects || object_count == 0;
+	}
+
+	bool has( id_type id )
+	{
+		return ( id & p::index_mask ) < index_count && indices[id & p::index_mask].id == id && indices[id & p::index_mask].idx != p::inner_mask;
+	}
+
+	const t& lookup( id_type id )
+	{
+		return objects[indices[id & p::index_mask].idx].second;
+	}
+
+	std::size_t size()
+	{
+		return object_count;
+	}
+
+	iter begin()
+	{
+		return objects;
+	}
+
+	iter end()
+	{
+		return objects + object_count;
+	}
+
+	mapped_store( const void* o = 0, std::size_t oc = 0, const void* i = 0, std::size_t ic = 0 ) :
+		objects( static_cast< const stored_type* >( o ) ), indices( static_cast< const index* >( i ) ), object_count( oc ), index_count( ic ) {}
+};
+
+class snapshot
+{
+private:
+	const unsigned char* data;
+	std::size_t size;
+#ifdef _WIN32
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+	snapshot( const snapshot& );
+	snapshot& operator=( const snapshot& );
+
+	const snapshot_header& header()
+	{
+		return *reinterpret_cast< const snapshot_header* >( data );
+	}
+
+	bool check()
+	{
+		if( size < sizeof( snapshot_header ) )
+		{
+			return false;
+		}
+
+		const snapshot_header& h = header();
+		return std::memcmp( h.magic, "OMSNAP\0\0", 8 ) == 0 &&
+		       h.version == snapshot_version &&
+		       h.byte_order == snapshot_byte_order &&
+		       h.sections_offset % sizeof( std::uint64_t ) == 0 &&
+		       h.sections_offset <= size &&
+		       h.section_count <= ( size - h.sections_offset ) / sizeof( snapshot_section ) &&
+		       check_strings();
+	}
+
+	//the string table fits in the file and every string in it ends inside the table
+	bool check_strings()
+	{
+		const snapshot_header& h = header();
+		if( h.strings_offset > size || h.strings_offset % sizeof( std::uint64_t ) != 0 || size - h.strings_offset < sizeof( std::uint64_t ) )
+		{
+			return false;
+		}
+
+		const std::uint64_t* table = reinterpret_cast< const std::uint64_t* >( data + h.strings_offset );
+		std::uint64_t count = table[0];
+		if( count >= ( size - h.strings_offset ) / sizeof( std::uint64_t ) - 1 ) //count + 1 offsets after the count
+		{
+			return false;
+		}
+
+		const std::uint64_t* offsets = table + 1;
+		const char* chars = reinterpret_cast< const char* >( offsets + count + 1 );
+		std::uint64_t length = size - ( reinterpret_cast< const unsigned char* >( chars ) - data );
+		if( offsets[count] > length )
+		{
+			return false;
+		}
+
+		for( std::uint64_t c = 0; c < count; ++c )
+		{
+			if( offsets[c] >= offsets[c + 1] || chars[offsets[c + 1] - 1] != 0 )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	//the section with the tag, if its sizes match and it fits in the file
+	const snapshot_section* find( std::uint32_t tag, std::size_t object_size, std::size_t id_size, std::size_t index_size )
+	{
+		if( !data )
+		{
+			return 0;
+		}
+
+		const snapshot_section* s = reinterpret_cast< const snapshot_section* >( data + header().sections_offset );
+		for( std::uint32_t c = 0; c < header().section_count; ++c, ++s )
+		{
+			if( s->tag == tag )
+			{
+				bool fits = s->object_size == object_size &&
+				            s->id_size == id_size &&
+				            s->index_size == index_size &&
+				            s->objects_offset <= size &&
+				            s->object_count <= ( size - s->objects_offset ) / object_size &&
+				            s->indices_offset <= size &&
+				            s->index_count <= ( size - s->indices_offset ) / index_size;
+				return fits ? s : 0;
+			}
+		}
+
+		return 0;
+	}
+
+	//every index entry points at a saved object and a saved index, or at nothing
+	template< class p >
+	bool check_indices( const snapshot_section* s )
+	{
+		typedef basic_index< p > index;
+		if( s->indices_offset % std::alignment_of< index >::value != 0 || s->index_count > p::inner_mask )
+		{
+			return false;
+		}
+
+		const index* indices = reinterpret_cast< const index* >( data + s->indices_offset );
+		for( std::uint64_t c = 0; c < s->index_count; ++c )
+		{
+			if( ( indices[c].idx != p::inner_mask && indices[c].idx >= s->object_count ) ||
+			    ( indices[c].next != p::inner_mask && indices[c].next >= s->index_count ) )
+			{
+				return false;
+			}
+		}
+
+		return ( s->freelist_enqueue == p::inner_mask || s->freelist_enqueue < s->index_count ) &&
+		       ( s->freelist_dequeue == p::inner_mask || s->freelist_dequeue < s->index_count );
+	}
+
+	template< class r, class t, class p >
+	const snapshot_section* find( std::uint32_t tag, object_manager< t, p >& )
+	{
+		const snapshot_section* s = find( tag, sizeof( std::pair< typename p::id_type, r > ), sizeof( typename p::id_type ), sizeof( typename object_manager< t, p >::index ) );
+		return s && check_indices< p >( s ) ? s : 0;
+	}
+
+	template< class t, class p >
+	void restore_indices( const snapshot_section* s, object_manager< t, p >& store )
+	{
+		typedef typename object_manager< t, p >::index index;
+		const index* first = reinterpret_cast< const index* >( data + s->indices_offset );
+		store.get_indices().assign( first, first + s->index_count );
+		store.set_freelist( static_cast< typename p::inner_id_type >( s->freelist_enqueue ), static_cast< typename p::inner_id_type >( s->freelist_dequeue ) );
+	}
+protected:
+public:
+	//maps the file, returns false if it can't be read or was written by an incompatible build
+	bool open( const char* path )
+	{
+		close();
+
+#ifdef _WIN32
+		file = CreateFileA( path, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, 0 );
+		if( file == INVALID_HANDLE_VALUE )
+		{
+			return false;
+		}
+
+		LARGE_INTEGER s;
+		GetFileSizeEx( file, &s );
+		size = static_cast< std::size_t >( s.QuadPart );
+
+		mapping = size ? CreateFileMappingA( file, 0, PAGE_READONLY, 0, 0, 0 ) : 0;
+		if( mapping )
+		{
+			data = static_cast< const unsigned char* >( MapViewOfFile( mapping, FILE_MAP_READ, 0, 0, 0 ) );
+		}
+#else
+		int fd = ::open( path, O_RDONLY );
+		if( fd < 0 )
+		{
+			return false;
+		}
+
+		struct stat st;
+		if( fstat( fd, &st ) == 0 && st.st_size > 0 )
+		{
+			size = static_cast< std::size_t >( st.st_size );
+			void* p = mmap( 0, size, PROT_READ, MAP_PRIVATE, fd, 0 );
+			data = p == MAP_FAILED ? 0 : static_cast< const unsigned char* >( p );
+		}
+		::close( fd ); //the mapping keeps the file alive
+#endif
+
+		if( !data || !check() )
+		{
+			close();
+			return false;
+		}
+
+		return true;
+	}
+
+	void close()
+	{
+#ifdef _WIN32
+		if( data )
+		{
+			UnmapViewOfFile( data );
+		}
+		if( mapping )
+		{
+			CloseHandle( mapping );
+		}
+		if( file != INVALID_HANDLE_VALUE )
+		{
+			CloseHandle( file );
+		}
+		mapping = 0;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if( data )
+		{
+			munmap( const_cast< unsigned char* >( data ), size );
+		}
+#endif
+		data = 0;
+		size = 0;
+	}
+
+	bool has( std::uint32_t tag )
+	{
+		if( !data )
+		{
+			return false;
+		}
+
+		const snapshot_section* s = reinterpret_cast< const snapshot_section* >( data + header().sections_offset );
+		for( std::uint32_t c = 0; c < header().section_count; ++c )
+		{
+			if( s[c].tag == tag )
+			{
+				return true;
+			}
+		}
+
+		return false;
+	}
+
+	//replaces the contents of store with the saved ones, false if there is no such section
+	template< class t, class p >
+	bool load( std::uint32_t tag, object_manager< t, p >& store )
+	{
+		static_assert( std::is_trivially_copyable< t >::value, "use load_as() for types that are not trivially copyable" );
+		typedef std::pair< typename p::id_type, t > stored_type;
+
+		const snapshot_section* s = find< t >( tag, store );
+		if( !s )
+		{
+			return false;
+		}
+
+		const stored_type* first = reinterpret_cast< const stored_type* >( data + s->objects_offset );
+		store.get_objects().assign( first, first + s->object_count );
+		restore_indices( s, store );
+		return true;
+	}
+
+	//the counterpart of write_as(), restore( record ) gives back the object
+	template< class r, class t, class p, class f >
+	bool load_as( std::uint32_t tag, object_manager< t, p >& store, f restore )
+	{
+		typedef std::pair< typename p::id_type, r > record_type;
+
+		const snapshot_section* s = find< r >( tag, store );
+		if( !s )
+		{
+			return false;
+		}
+
+		const record_type* first = reinterpret_cast< const record_type* >( data + s->objects_offset );
+		auto& objects = store.get_objects();
+		objects.clear();
+		objects.reserve( s->object_count );
+		for( std::size_t c = 0; c < s->object_count; ++c )
+		{
+			objects.push_back( std::make_pair( first[c].first, restore( first[c].second ) ) );
+		}
+
+		restore_indices( s, store );
+		return true;
+	}
+
+	//uses the saved arrays in place, without copying, check valid() on the result
+	template< class t, class p = default_handle >
+	mapped_store< t, p > map( std::uint32_t tag )
+	{
+		static_assert( std::is_trivially_copyable< t >::value, "only trivially copyable types can be used in place" );
+		typedef std::pair< typename p::id_type, t > stored_type;
+
+		const snapshot_section* s = find( tag, sizeof( stored_type ), sizeof( typename p::id_type ), sizeof( basic_index< p > ) );
+		if( !s || s->objects_offset % std::alignment_of< stored_type >::value != 0 || !check_indices< p >( s ) )
+		{
+			return mapped_store< t, p >();
+		}
+
+		return mapped_store< t, p >( data + s->objects_offset, s->object_count, data + s->indices_offset, s->index_count );
+	}
+
+	std::size_t string_count()
+	{
+		return data ? static_cast< std::size_t >( *reinterpret_cast< const std::uint64_t* >( data + header().strings_offset ) ) : 0;
+	}
+
+	//a string added with add_string(), 0 terminated, 0 if there is no such string
+	const char* get_string( std::uint32_t id )
+	{
+		if( id >= string_count() )
+		{
+			return 0;
+		}
+
+		const std::uint64_t* offsets = reinterpret_cast< const std::uint64_t* >( data + header().strings_offset ) + 1;
+		const char* chars = reinterpret_cast< const char* >( offsets + string_count() + 1 );
+		return chars + offsets[id];
+	}
+
+#ifdef _WIN32
+	snapshot() : data( 0 ), size( 0 ), file( INVALID_HANDLE_VALUE ), mapping( 0 ) {}
+#else
+	snapshot() : data( 0 ), size( 0 ) {}
+#endif
+
+	~snapshot()
+	{
+		close();
+	}
+};
+
+}
+
+#endif
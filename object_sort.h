@@ -0,0 +1,211 @@
+#ifndef object_sort_h
+#define object_sort_h
+
+#include <vector>
+#include <utility>
+#include <limits>
+#include <chrono>
+#include <functional>
+#include <cstddef>
+
+#include "object_manager.h"
+
+namespace om
+{
+
+/*
+ * Moves the objects of an object_manager toward a sorted order, a little each frame.
+ *
+ * sort_by() or reorder_to_match() start a pass, then step() is called with a time
+ * budget until it returns true. A pass snapshots the handles, computes the keys,
+ * merge sorts them and then swaps every object into its place. Every phase can stop
+ * at any point and continue on the next step. Handles stay valid the whole time.
+ *
+ * The store can change between steps. Objects removed since the pass started are
+ * skipped, and new ones end up behind the sorted ones. The order is not exact then,
+ * but it keeps getting closer with each pass.
+ * Don't reorder a store that a group owns, the group keeps its own order.
+ */
+template< class t, class k = std::size_t, class p = default_handle >
+class incremental_sort
+{
+private:
+	enum phase
+	{
+		idle, keying, merging, applying
+	};
+
+	typedef std::pair< k, typename p::id_type > item;
+	typedef std::chrono::steady_clock clock;
+
+	object_manager< t, p >& store;
+	std::function< k( const t& ) > key;
+	std::vector< item > items;
+	std::vector< item > scratch;
+	phase state;
+	std::size_t cursor; //next item to key, or to put in place
+	std::size_t pos; //next position to fill when applying
+	std::size_t width, lo, left, right, out; //merge sort state
+
+	incremental_sort( const incremental_sort& );
+	incremental_sort& operator=( const incremental_sort& );
+
+	//one unit of work, returns false when the current phase ran out
+	bool work()
+	{
+		switch( state )
+		{
+		case keying:
+			if( cursor == items.size() )
+			{
+				state = merging;
+				width = 1;
+				lo = 0;
+				start_merge();
+				return true;
+			}
+
+			if( store.has( items[cursor].second ) )
+			{
+				items[cursor].first = key( store.read( items[cursor].second ) );
+			}
+			else
+			{
+				items[cursor].first = std::numeric_limits< k >::max();
+			}
+			++cursor;
+			return true;
+		case merging:
+			if( width >= items.size() )
+			{
+				state = applying;
+				cursor = 0;
+				pos = 0;
+				return true;
+			}
+
+			merge_one();
+			return true;
+		case applying:
+			if( cursor == items.size() || pos >= store.get_objects().size() )
+			{
+				state = idle;
+				return false;
+			}
+
+			if( store.has( items[cursor].second ) )
+			{
+				store.swap( store.slot( items[cursor].second ), pos );
+				++pos;
+			}
+			++cursor;
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void start_merge()
+	{
+		left = lo;
+		right = lo + width < items.size() ? lo + width : items.size();
+		out = lo;
+	}
+
+	//moves one item of the current pair of runs into scratch
+	void merge_one()
+	{
+		std::size_t mid = lo + width < items.size() ? lo + width : items.size();
+		std::size_t hi = lo + 2 * width < items.size() ? lo + 2 * width : items.size();
+
+		if( out < hi )
+		{
+			if( left < mid && ( right >= hi || !( items[right].first < items[left].first ) ) )
+			{
+				scratch[out++] = items[left++];
+			}
+			else
+			{
+				scratch[out++] = items[right++];
+			}
+		}
+
+		if( out == hi ) //pair done, go to the next one
+		{
+			lo = hi;
+			if( lo >= items.size() ) //pass done
+			{
+				items.swap( scratch );
+				width *= 2;
+				lo = 0;
+			}
+			start_merge();
+		}
+	}
+protected:
+public:
+	//starts a pass that orders the objects by ascending key( object )
+	template< class f >
+	void sort_by( f func )
+	{
+		key = func;
+		items.clear();
+
+		auto& objects = store.get_objects();
+		items.reserve( objects.size() );
+		for( auto c = objects.begin(); c != objects.end(); ++c )
+		{
+			items.push_back( item( k(), c->first ) );
+		}
+
+		scratch.resize( items.size() );
+		cursor = 0;
+		state = keying;
+	}
+
+	//starts a pass that orders the components in the order their entities have in other
+	//t needs an 'id' member with the owning entity, other is a component_store
+	template< class o >
+	void reorder_to_match( o& other )
+	{
+		sort_by( [&other]( const t& d ) -> k
+		{
+			return other.has_for_entity( d.id ) ? k( other.slot_for_entity( d.id ) ) : std::numeric_limits< k >::max();
+		} );
+	}
+
+	//works for at most budget, returns true when there is nothing left to do
+	bool step( std::chrono::microseconds budget )
+	{
+		clock::time_point end = clock::now() + budget;
+
+		while( state != idle )
+		{
+			for( int c = 0; c < 256; ++c ) //don't look at the clock for every item
+			{
+				if( !work() )
+				{
+					break;
+				}
+			}
+
+			if( clock::now() >= end )
+			{
+				break;
+			}
+		}
+
+		return state == idle;
+	}
+
+	bool done()
+	{
+		return state == idle;
+	}
+
+	incremental_sort( object_manager< t, p >& s ) : store( s ), state( idle ), cursor( 0 ), pos( 0 ), width( 1 ), lo( 0 ), left( 0 ), right( 0 ), out( 0 ) {}
+};
+
+}
+
+#endif
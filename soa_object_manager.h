@@ -0,0 +1,287 @@
+#ifndef soa_object_manager_h
+#define soa_object_manager_h
+
+#include <vector>
+#include <tuple>
+#include <new>
+#include <cstddef>
+#include <cstdint>
+
+#include "object_manager.h"
+
+/*
+ * Structure-of-arrays variant of om::object_manager.
+ *
+ * Every reflected field of the stored type gets its own contiguous column, and the
+ * owner ids live in a column of their own. A pass that only touches x and y then
+ * only pulls those two columns into the cache.
+ *
+ * A type is reflected by listing its fields with OM_SOA_LAYOUT at global scope:
+ *
+ *   OM_SOA_LAYOUT( ces::component::pos, &ces::component::pos::x, &ces::component::pos::y, &ces::component::pos::z )
+ *
+ * Fields that are not listed are not stored, lookup() gives them their default value.
+ *
+ * Columns start on a cache line and their storage is padded to whole cache lines, so
+ * vector loads over a column never straddle lines and two columns never share one
+ * (see soa_simd.h).
+ */
+
+namespace om
+{
+
+template< class t >
+struct soa_layout; //specialized through OM_SOA_LAYOUT
+
+//allocates alignment aligned blocks, rounded up to whole multiples of alignment
+template< class t, std::size_t alignment = 64 >
+class aligned_allocator
+{
+public:
+	typedef t value_type;
+
+	template< class u >
+	struct rebind
+	{
+		typedef aligned_allocator< u, alignment > other;
+	};
+
+	t* allocate( std::size_t n )
+	{
+		std::size_t size = ( n * sizeof( t ) + alignment - 1 ) / alignment * alignment;
+
+		//the block the pointer came from is kept right before the aligned memory
+		char* block = static_cast< char* >( ::operator new( size + alignment + sizeof( void* ) ) );
+		char* first = block + sizeof( void* );
+		char* aligned = first + ( alignment - reinterpret_cast< std::uintptr_t >( first ) % alignment ) % alignment;
+		reinterpret_cast< void** >( aligned )[-1] = block;
+
+		return reinterpret_cast< t* >( aligned );
+	}
+
+	void deallocate( t* p, std::size_t )
+	{
+		::operator delete( reinterpret_cast< void** >( p )[-1] );
+	}
+
+	aligned_allocator() {}
+
+	template< class u >
+	aligned_allocator( const aligned_allocator< u, alignment >& ) {}
+};
+
+template< class t, class u, std::size_t a >
+bool operator==( const aligned_allocator< t, a >&, const aligned_allocator< u, a >& )
+{
+	return true;
+}
+
+template< class t, class u, std::size_t a >
+bool operator!=( const aligned_allocator< t, a >&, const aligned_allocator< u, a >& )
+{
+	return false;
+}
+
+namespace detail
+{
+	template< class m >
+	struct member_type;
+
+	template< class c, class m >
+	struct member_type< m c::* >
+	{
+		typedef m type;
+	};
+
+	template< class f >
+	struct soa_columns;
+
+	template< class... m >
+	struct soa_columns< std::tuple< m... > >
+	{
+		typedef std::tuple< std::vector< typename member_type< m >::type, aligned_allocator< typename member_type< m >::type > >... > type;
+	};
+}
+
+template< class t, class h = default_handle >
+class soa_object_manager
+{
+public:
+	typedef h handle_type;
+	typedef typename h::id_type id_type;
+	typedef typename h::inner_id_type inner_id_type;
+	typedef basic_index< h > index;
+
+	typedef decltype( soa_layout< t >::fields() ) fields_type;
+	typedef typename detail::soa_columns< fields_type >::type columns_type;
+	typedef typename detail::gen_seq< std::tuple_size< fields_type >::value >::type field_seq;
+
+	template< std::size_t n >
+	struct column_type
+	{
+		typedef typename std::tuple_element< n, columns_type >::type::value_type type;
+	};
+private:
+	columns_type columns;
+	std::vector< id_type > ids; //owner id column
+	std::vector< index > indices;
+	inner_id_type freelist_enqueue; //last free index, inner_mask if there is none
+	inner_id_type freelist_dequeue; //first free index, inner_mask if there is none
+
+	//takes the oldest free index, or makes a new one
+	index& take_index()
+	{
+		if( freelist_dequeue == h::inner_mask )
+		{
+			indices.push_back( index( indices.size() ) );
+			return indices.back();
+		}
+
+		index& in = indices[freelist_dequeue];
+		freelist_dequeue = in.next;
+
+		if( freelist_dequeue == h::inner_mask )
+		{
+			freelist_enqueue = h::inner_mask;
+		}
+
+		return in;
+	}
+
+	//queues an index for reuse
+	void free_index( inner_id_type i )
+	{
+		indices[i].idx = h::inner_mask;
+		indices[i].next = h::inner_mask;
+
+		if( freelist_enqueue == h::inner_mask )
+		{
+			freelist_dequeue = i;
+		}
+		else
+		{
+			indices[freelist_enqueue].next = i;
+		}
+
+		freelist_enqueue = i;
+	}
+
+	template< std::size_t... n >
+	void push( const t& d, detail::seq< n... > )
+	{
+		fields_type f = soa_layout< t >::fields();
+		detail::expand( { ( std::get< n >( columns ).push_back( d.*std::get< n >( f ) ), 0 )... } );
+	}
+
+	template< std::size_t... n >
+	void scatter( const t& d, inner_id_type i, detail::seq< n... > )
+	{
+		fields_type f = soa_layout< t >::fields();
+		detail::expand( { ( std::get< n >( columns )[i] = d.*std::get< n >( f ), 0 )... } );
+	}
+
+	template< std::size_t... n >
+	void gather( t& d, inner_id_type i, detail::seq< n... > ) const
+	{
+		fields_type f = soa_layout< t >::fields();
+		detail::expand( { ( d.*std::get< n >( f ) = std::get< n >( columns )[i], 0 )... } );
+	}
+
+	template< std::size_t... n >
+	void move_and_pop( inner_id_type to, detail::seq< n... > )
+	{
+		detail::expand( { ( std::get< n >( columns )[to] = std::get< n >( columns ).back(),
+		                    std::get< n >( columns ).pop_back(), 0 )... } );
+	}
+protected:
+public:
+	bool has( id_type id )
+	{
+		index& in = indices[id & h::index_mask];
+		return in.id == id && in.idx != h::inner_mask;
+	}
+
+	//position of the object in the columns
+	inner_id_type slot( id_type id )
+	{
+		return indices[id & h::index_mask].idx;
+	}
+
+	//reassembles the object from its columns
+	t lookup( id_type id ) const
+	{
+		t d;
+		gather( d, indices[id & h::index_mask].idx, field_seq() );
+		return d;
+	}
+
+	//writes every field of the object back into the columns
+	void store( id_type id, const t& d )
+	{
+		scatter( d, indices[id & h::index_mask].idx, field_seq() );
+	}
+
+	//direct access to one field of one object
+	template< std::size_t n >
+	typename column_type< n >::type& get( id_type id )
+	{
+		return std::get< n >( columns )[indices[id & h::index_mask].idx];
+	}
+
+	id_type add( const t& d )
+	{
+		index& in = take_index();
+		in.id = ( in.id + h::generation_add ) & h::id_mask;
+		in.idx = ids.size();
+		ids.push_back( in.id );
+		push( d, field_seq() );
+		return in.id;
+	}
+
+	void remove( id_type id )
+	{
+		index& in = indices[id & h::index_mask];
+
+		//swap and pop, column by column
+		ids[in.idx] = ids.back();
+		ids.pop_back();
+		move_and_pop( in.idx, field_seq() );
+		if( in.idx < ids.size() )
+		{
+			indices[ids[in.idx] & h::index_mask].idx = in.idx;
+		}
+
+		free_index( id & h::index_mask );
+	}
+
+	std::size_t size() const
+	{
+		return ids.size();
+	}
+
+	template< std::size_t n >
+	typename std::tuple_element< n, columns_type >::type& column()
+	{
+		return std::get< n >( columns );
+	}
+
+	std::vector< id_type >& get_ids()
+	{
+		return ids;
+	}
+
+	soa_object_manager()
+	{
+		freelist_enqueue = h::inner_mask;
+		freelist_dequeue = h::inner_mask;
+	}
+};
+
+}
+
+#define OM_SOA_LAYOUT( type, ... ) \
+	namespace om { template<> struct soa_layout< type > { \
+		static auto fields() -> decltype( std::make_tuple( __VA_ARGS__ ) ) { return std::make_tuple( __VA_ARGS__ ); } \
+	}; }
+
+#endif
@@ -0,0 +1,447 @@
+#ifndef soa_simd_h
+#define soa_simd_h
+
+#include <cstddef>
+#include <cstdint>
+
+#if defined( __x86_64__ ) || defined( _M_X64 ) || defined( __i386__ ) || defined( _M_IX86 )
+#define OM_SIMD_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+//lets a function use an instruction set the rest of the build doesn't assume
+#if defined( OM_SIMD_X86 ) && ( defined( __GNUC__ ) || defined( __clang__ ) )
+#define OM_SIMD_TARGET( isa ) __attribute__(( target( isa ) ))
+#else
+#define OM_SIMD_TARGET( isa )
+#endif
+
+namespace om
+{
+
+/*
+ * Vector kernels for position and velocity like data kept in soa_object_manager
+ * columns: integration, affine transforms, and box and sphere tests.
+ *
+ * The instruction set is picked once at runtime, the best of AVX2, SSE and plain
+ * scalar code the CPU supports, so the build doesn't have to assume AVX2.
+ * Each kernel works on n consecutive slots of three float columns:
+ *
+ *   OM_SOA_LAYOUT( body, &body::x, &body::y, &body::z, &body::vx, &body::vy, &body::vz )
+ *
+ *   om::simd::integrate( om::simd::columns< 0, 1, 2 >( bodies ), om::simd::columns< 3, 4, 5 >( bodies ), dt, bodies.size() );
+ *
+ * The columns are cache line aligned, so the full vectors never straddle a line,
+ * the last few slots are done one by one. The vector code only does what the scalar
+ * code does (no fused multiply-add), so every level gives the same results.
+ */
+namespace simd
+{
+	enum level
+	{
+		scalar, sse, avx2
+	};
+
+	//three columns of floats, one point or vector per slot
+	struct float3_columns
+	{
+		float* x;
+		float* y;
+		float* z;
+	};
+
+	//the columns a, b and c of a soa_object_manager
+	template< std::size_t a, std::size_t b, std::size_t c, class m >
+	float3_columns columns( m& store )
+	{
+		float3_columns result = { store.template column< a >().data(), store.template column< b >().data(), store.template column< c >().data() };
+		return result;
+	}
+
+	namespace detail
+	{
+		struct kernel_table
+		{
+			void ( *integrate )( float3_columns p, float3_columns v, float dt, std::size_t n );
+			void ( *transform )( float3_columns p, const float* m, std::size_t n );
+			std::size_t ( *in_box )( float3_columns p, const float* lo, const float* hi, std::uint32_t* out, std::size_t n );
+			std::size_t ( *in_sphere )( float3_columns p, const float* center, float radius, std::uint32_t* out, std::size_t n );
+		};
+
+		//the slot at, from the vector kernels' tails as well
+		inline void integrate_one( float3_columns p, float3_columns v, float dt, std::size_t at )
+		{
+			p.x[at] += v.x[at] * dt;
+			p.y[at] += v.y[at] * dt;
+			p.z[at] += v.z[at] * dt;
+		}
+
+		inline void transform_one( float3_columns p, const float* m, std::size_t at )
+		{
+			float x = p.x[at], y = p.y[at], z = p.z[at];
+			p.x[at] = m[0] * x + m[1] * y + m[2] * z + m[3];
+			p.y[at] = m[4] * x + m[5] * y + m[6] * z + m[7];
+			p.z[at] = m[8] * x + m[9] * y + m[10] * z + m[11];
+		}
+
+		inline bool in_box_one( float3_columns p, const float* lo, const float* hi, std::size_t at )
+		{
+			return p.x[at] >= lo[0] && p.x[at] <= hi[0] &&
+			       p.y[at] >= lo[1] && p.y[at] <= hi[1] &&
+			       p.z[at] >= lo[2] && p.z[at] <= hi[2];
+		}
+
+		inline bool in_sphere_one( float3_columns p, const float* center, float radius, std::size_t at )
+		{
+			float dx = p.x[at] - center[0], dy = p.y[at] - center[1], dz = p.z[at] - center[2];
+			return dx * dx + dy * dy + dz * dz <= radius * radius;
+		}
+
+		//appends the slots of the set bits of mask, lanes slots from at
+		inline std::size_t compact( unsigned mask, std::size_t lanes, std::size_t at, std::uint32_t* out, std::size_t count )
+		{
+			for( std::size_t c = 0; c < lanes; ++c )
+			{
+				out[count] = std::uint32_t( at + c );
+				count += ( mask >> c ) & 1;
+			}
+			return count;
+		}
+
+		inline void integrate_scalar( float3_columns p, float3_columns v, float dt, std::size_t n )
+		{
+			for( std::size_t c = 0; c < n; ++c )
+			{
+				integrate_one( p, v, dt, c );
+			}
+		}
+
+		inline void transform_scalar( float3_columns p, const float* m, std::size_t n )
+		{
+			for( std::size_t c = 0; c < n; ++c )
+			{
+				transform_one( p, m, c );
+			}
+		}
+
+		inline std::size_t in_box_scalar( float3_columns p, const float* lo, const float* hi, std::uint32_t* out, std::size_t n )
+		{
+			std::size_t count = 0;
+			for( std::size_t c = 0; c < n; ++c )
+			{
+				out[count] = std::uint32_t( c );
+				count += in_box_one( p, lo, hi, c );
+			}
+			return count;
+		}
+
+		inline std::size_t in_sphere_scalar( float3_columns p, const float* center, float radius, std::uint32_t* out, std::size_t n )
+		{
+			std::size_t count = 0;
+			for( std::size_t c = 0; c < n; ++c )
+			{
+				out[count] = std::uint32_t( c );
+				count += in_sphere_one( p, center, radius, c );
+			}
+			return count;
+		}
+
+#ifdef OM_SIMD_X86
+		OM_SIMD_TARGET( "sse2" )
+		inline void integrate_sse( float3_columns p, float3_columns v, float dt, std::size_t n )
+		{
+			__m128 d = _mm_set1_ps( dt );
+			std::size_t c = 0;
+			for( ; c + 4 <= n; c += 4 )
+			{
+				_mm_storeu_ps( p.x + c, _mm_add_ps( _mm_loadu_ps( p.x + c ), _mm_mul_ps( _mm_loadu_ps( v.x + c ), d ) ) );
+				_mm_storeu_ps( p.y + c, _mm_add_ps( _mm_loadu_ps( p.y + c ), _mm_mul_ps( _mm_loadu_ps( v.y + c ), d ) ) );
+				_mm_storeu_ps( p.z + c, _mm_add_ps( _mm_loadu_ps( p.z + c ), _mm_mul_ps( _mm_loadu_ps( v.z + c ), d ) ) );
+			}
+			for( ; c < n; ++c )
+			{
+				integrate_one( p, v, dt, c );
+			}
+		}
+
+		OM_SIMD_TARGET( "sse2" )
+		inline void transform_sse( float3_columns p, const float* m, std::size_t n )
+		{
+			__m128 r[12];
+			for( int c = 0; c < 12; ++c )
+			{
+				r[c] = _mm_set1_ps( m[c] );
+			}
+
+			std::size_t c = 0;
+			for( ; c + 4 <= n; c += 4 )
+			{
+				__m128 x = _mm_loadu_ps( p.x + c ), y = _mm_loadu_ps( p.y + c ), z = _mm_loadu_ps( p.z + c );
+				_mm_storeu_ps( p.x + c, _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( r[0], x ), _mm_mul_ps( r[1], y ) ), _mm_mul_ps( r[2], z ) ), r[3] ) );
+				_mm_storeu_ps( p.y + c, _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( r[4], x ), _mm_mul_ps( r[5], y ) ), _mm_mul_ps( r[6], z ) ), r[7] ) );
+				_mm_storeu_ps( p.z + c, _mm_add_ps( _mm_add_ps( _mm_add_ps( _mm_mul_ps( r[8], x ), _mm_mul_ps( r[9], y ) ), _mm_mul_ps( r[10], z ) ), r[11] ) );
+			}
+			for( ; c < n; ++c )
+			{
+				transform_one( p, m, c );
+			}
+		}
+
+		OM_SIMD_TARGET( "sse2" )
+		inline std::size_t in_box_sse( float3_columns p, const float* lo, const float* hi, std::uint32_t* out, std::size_t n )
+		{
+			__m128 lx = _mm_set1_ps( lo[0] ), ly = _mm_set1_ps( lo[1] ), lz = _mm_set1_ps( lo[2] );
+			__m128 hx = _mm_set1_ps( hi[0] ), hy = _mm_set1_ps( hi[1] ), hz = _mm_set1_ps( hi[2] );
+
+			std::size_t count = 0, c = 0;
+			for( ; c + 4 <= n; c += 4 )
+			{
+				__m128 x = _mm_loadu_ps( p.x + c ), y = _mm_loadu_ps( p.y + c ), z = _mm_loadu_ps( p.z + c );
+				__m128 inside = _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( x, lx ), _mm_cmple_ps( x, hx ) ),
+				                _mm_and_ps( _mm_and_ps( _mm_cmpge_ps( y, ly ), _mm_cmple_ps( y, hy ) ),
+				                            _mm_and_ps( _mm_cmpge_ps( z, lz ), _mm_cmple_ps( z, hz ) ) ) );
+				count = compact( unsigned( _mm_movemask_ps( inside ) ), 4, c, out, count );
+			}
+			for( ; c < n; ++c )
+			{
+				out[count] = std::uint32_t( c );
+				count += in_box_one( p, lo, hi, c );
+			}
+			return count;
+		}
+
+		OM_SIMD_TARGET( "sse2" )
+		inline std::size_t in_sphere_sse( float3_columns p, const float* center, float radius, std::uint32_t* out, std::size_t n )
+		{
+			__m128 cx = _mm_set1_ps( center[0] ), cy = _mm_set1_ps( center[1] ), cz = _mm_set1_ps( center[2] );
+			__m128 r2 = _mm_set1_ps( radius * radius );
+
+			std::size_t count = 0, c = 0;
+			for( ; c + 4 <= n; c += 4 )
+			{
+				__m128 dx = _mm_sub_ps( _mm_loadu_ps( p.x + c ), cx );
+				__m128 dy = _mm_sub_ps( _mm_loadu_ps( p.y + c ), cy );
+				__m128 dz = _mm_sub_ps( _mm_loadu_ps( p.z + c ), cz );
+				__m128 d2 = _mm_add_ps( _mm_add_ps( _mm_mul_ps( dx, dx ), _mm_mul_ps( dy, dy ) ), _mm_mul_ps( dz, dz ) );
+				count = compact( unsigned( _mm_movemask_ps( _mm_cmple_ps( d2, r2 ) ) ), 4, c, out, count );
+			}
+			for( ; c < n; ++c )
+			{
+				out[count] = std::uint32_t( c );
+				count += in_sphere_one( p, center, radius, c );
+			}
+			return count;
+		}
+
+		OM_SIMD_TARGET( "avx2" )
+		inline void integrate_avx2( float3_columns p, float3_columns v, float dt, std::size_t n )
+		{
+			__m256 d = _mm256_set1_ps( dt );
+			std::size_t c = 0;
+			for( ; c + 8 <= n; c += 8 )
+			{
+				_mm256_storeu_ps( p.x + c, _mm256_add_ps( _mm256_loadu_ps( p.x + c ), _mm256_mul_ps( _mm256_loadu_ps( v.x + c ), d ) ) );
+				_mm256_storeu_ps( p.y + c, _mm256_add_ps( _mm256_loadu_ps( p.y + c ), _mm256_mul_ps( _mm256_loadu_ps( v.y + c ), d ) ) );
+				_mm256_storeu_ps( p.z + c, _mm256_add_ps( _mm256_loadu_ps( p.z + c ), _mm256_mul_ps( _mm256_loadu_ps( v.z + c ), d ) ) );
+			}
+			for( ; c < n; ++c )
+			{
+				integrate_one( p, v, dt, c );
+			}
+		}
+
+		OM_SIMD_TARGET( "avx2" )
+		inline void transform_avx2( float3_columns p, const float* m, std::size_t n )
+		{
+			__m256 r[12];
+			for( int c = 0; c < 12; ++c )
+			{
+				r[c] = _mm256_set1_ps( m[c] );
+			}
+
+			std::size_t c = 0;
+			for( ; c + 8 <= n; c += 8 )
+			{
+				__m256 x = _mm256_loadu_ps( p.x + c ), y = _mm256_loadu_ps( p.y + c ), z = _mm256_loadu_ps( p.z + c );
+				_mm256_storeu_ps( p.x + c, _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r[0], x ), _mm256_mul_ps( r[1], y ) ), _mm256_mul_ps( r[2], z ) ), r[3] ) );
+				_mm256_storeu_ps( p.y + c, _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r[4], x ), _mm256_mul_ps( r[5], y ) ), _mm256_mul_ps( r[6], z ) ), r[7] ) );
+				_mm256_storeu_ps( p.z + c, _mm256_add_ps( _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( r[8], x ), _mm256_mul_ps( r[9], y ) ), _mm256_mul_ps( r[10], z ) ), r[11] ) );
+			}
+			for( ; c < n; ++c )
+			{
+				transform_one( p, m, c );
+			}
+		}
+
+		OM_SIMD_TARGET( "avx2" )
+		inline std::size_t in_box_avx2( float3_columns p, const float* lo, const float* hi, std::uint32_t* out, std::size_t n )
+		{
+			__m256 lx = _mm256_set1_ps( lo[0] ), ly = _mm256_set1_ps( lo[1] ), lz = _mm256_set1_ps( lo[2] );
+			__m256 hx = _mm256_set1_ps( hi[0] ), hy = _mm256_set1_ps( hi[1] ), hz = _mm256_set1_ps( hi[2] );
+
+			std::size_t count = 0, c = 0;
+			for( ; c + 8 <= n; c += 8 )
+			{
+				__m256 x = _mm256_loadu_ps( p.x + c ), y = _mm256_loadu_ps( p.y + c ), z = _mm256_loadu_ps( p.z + c );
+				__m256 inside = _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( x, lx, _CMP_GE_OQ ), _mm256_cmp_ps( x, hx, _CMP_LE_OQ ) ),
+				                _mm256_and_ps( _mm256_and_ps( _mm256_cmp_ps( y, ly, _CMP_GE_OQ ), _mm256_cmp_ps( y, hy, _CMP_LE_OQ ) ),
+				                               _mm256_and_ps( _mm256_cmp_ps( z, lz, _CMP_GE_OQ ), _mm256_cmp_ps( z, hz, _CMP_LE_OQ ) ) ) );
+				count = compact( unsigned( _mm256_movemask_ps( inside ) ), 8, c, out, count );
+			}
+			for( ; c < n; ++c )
+			{
+				out[count] = std::uint32_t( c );
+				count += in_box_one( p, lo, hi, c );
+			}
+			return count;
+		}
+
+		OM_SIMD_TARGET( "avx2" )
+		inline std::size_t in_sphere_avx2( float3_columns p, const float* center, float radius, std::uint32_t* out, std::size_t n )
+		{
+			__m256 cx = _mm256_set1_ps( center[0] ), cy = _mm256_set1_ps( center[1] ), cz = _mm256_set1_ps( center[2] );
+			__m256 r2 = _mm256_set1_ps( radius * radius );
+
+			std::size_t count = 0, c = 0;
+			for( ; c + 8 <= n; c += 8 )
+			{
+				__m256 dx = _mm256_sub_ps( _mm256_loadu_ps( p.x + c ), cx );
+				__m256 dy = _mm256_sub_ps( _mm256_loadu_ps( p.y + c ), cy );
+				__m256 dz = _mm256_sub_ps( _mm256_loadu_ps( p.z + c ), cz );
+				__m256 d2 = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( dx, dx ), _mm256_mul_ps( dy, dy ) ), _mm256_mul_ps( dz, dz ) );
+				count = compact( unsigned( _mm256_movemask_ps( _mm256_cmp_ps( d2, r2, _CMP_LE_OQ ) ) ), 8, c, out, count );
+			}
+			for( ; c < n; ++c )
+			{
+				out[count] = std::uint32_t( c );
+				count += in_sphere_one( p, center, radius, c );
+			}
+			return count;
+		}
+#endif
+
+		inline kernel_table table_for( level l )
+		{
+			kernel_table t = { integrate_scalar, transform_scalar, in_box_scalar, in_sphere_scalar };
+#ifdef OM_SIMD_X86
+			if( l == sse )
+			{
+				kernel_table s = { integrate_sse, transform_sse, in_box_sse, in_sphere_sse };
+				t = s;
+			}
+			else if( l == avx2 )
+			{
+				kernel_table a = { integrate_avx2, transform_avx2, in_box_avx2, in_sphere_avx2 };
+				t = a;
+			}
+#endif
+			return t;
+		}
+	}
+
+	//the best level this CPU (and OS) supports
+	inline level detect()
+	{
+#if defined( OM_SIMD_X86 ) && defined( _MSC_VER )
+		int r[4];
+		__cpuid( r, 0 );
+		int leaves = r[0];
+		__cpuid( r, 1 );
+		bool has_sse = ( r[3] & ( 1 << 26 ) ) != 0; //sse2
+		bool os_avx = ( r[2] & ( 1 << 27 ) ) && ( r[2] & ( 1 << 28 ) ) && ( _xgetbv( 0 ) & 6 ) == 6; //ymm state saved
+		if( os_avx && leaves >= 7 )
+		{
+			__cpuidex( r, 7, 0 );
+			if( r[1] & ( 1 << 5 ) )
+			{
+				return avx2;
+			}
+		}
+		return has_sse ? sse : scalar;
+#elif defined( OM_SIMD_X86 )
+		__builtin_cpu_init();
+		if( __builtin_cpu_supports( "avx2" ) )
+		{
+			return avx2;
+		}
+		return __builtin_cpu_supports( "sse2" ) ? sse : scalar;
+#else
+		return scalar;
+#endif
+	}
+
+	namespace detail
+	{
+		struct dispatch
+		{
+			level current;
+			kernel_table kernels;
+
+			dispatch() : current( detect() ), kernels( table_for( current ) ) {}
+		};
+
+		inline dispatch& get_dispatch()
+		{
+			static dispatch instance;
+			return instance;
+		}
+	}
+
+	inline level get_level()
+	{
+		return detail::get_dispatch().current;
+	}
+
+	//switches to a lower level, eg. to compare them
+	//returns false if the CPU doesn't support l
+	//not thread safe, call it when no kernel runs
+	inline bool set_level( level l )
+	{
+		if( l > detect() )
+		{
+			return false;
+		}
+
+		detail::get_dispatch().current = l;
+		detail::get_dispatch().kernels = detail::table_for( l );
+		return true;
+	}
+
+	inline const char* level_name( level l )
+	{
+		return l == avx2 ? "avx2" : l == sse ? "sse" : "scalar";
+	}
+
+	//p += v * dt
+	inline void integrate( float3_columns p, float3_columns v, float dt, std::size_t n )
+	{
+		detail::get_dispatch().kernels.integrate( p, v, dt, n );
+	}
+
+	//p = m * ( p, 1 ), m is a row major 3x4 affine matrix
+	inline void transform( float3_columns p, const float* m, std::size_t n )
+	{
+		detail::get_dispatch().kernels.transform( p, m, n );
+	}
+
+	//writes the slots of the points inside the box (bounds included) to out, returns how many
+	//out has to have room for n slots
+	inline std::size_t in_box( float3_columns p, const float* lo, const float* hi, std::uint32_t* out, std::size_t n )
+	{
+		return detail::get_dispatch().kernels.in_box( p, lo, hi, out, n );
+	}
+
+	//writes the slots of the points at most radius away from center to out, returns how many
+	//out has to have room for n slots
+	inline std::size_t in_sphere( float3_columns p, const float* center, float radius, std::uint32_t* out, std::size_t n )
+	{
+		return detail::get_dispatch().kernels.in_sphere( p, center, radius, out, n );
+	}
+}
+
+}
+
+#endif
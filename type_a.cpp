@@ -1,374 +1,785 @@
-#include <iostream>
-#include <list>
-
-#include "object_manager.h"
-#include "ces_callback.h"
-
-#define USE_TYPE_A
-#ifdef USE_TYPE_A
-
-/*
- * CES SYSTEM IMPLEMENTATION "A"
- *
- * In type A:
- * Systems are separate, they only contain logic, no data. They are wrapped around by a system-manager.
- * Entities are stored in an entity-manager.
- * Each entity contains a vector of components, and an ID that identifies the entity.
- * Systems ask the entity-manager for entities to process each time update is called on them by the system-manager.
- * Note that entities and components don't store their ID directly, they are rather just identified by systems and other objects by it.
- *
- * System Manager
- *   -Systems
- *     -type-id
- *
- * Entity manager
- *   -Entites
- *     -ID
- *     -Components
- *       -ID
- *       -type-id
- *       -data
- */
-
-using namespace std;
-
-enum
-{
-  EVENT_TYPE_ONE, EVENT_TYPE_TWO
-};
-
-/*
- * Components only contain data, no logic (only constructors/destructors maybe)
- */
-namespace ces
-{
-namespace component
-{
-  class base
-  {
-  public:
-    om::id_type id; //type id, assigned by a system
-  };
-
-  class pos : public base
-  {
-  public:
-    float x, y, z;
-    pos(float a = float(), float b = float(), float c = float()) : x(a), y(b), z(c) {}
-  };
-
-  class name : public base
-  {
-  public:
-    string str;
-    name(const string& n = string()) : str(n) {}
-  };
-}
-
-/*
- * Entities. In this type, they hold all the data, but no logic, systems process them.
- */
-namespace entity
-{
-  class base
-  {
-    om::object_manager< component::base* > components; //collection of components
-  public:
-    om::id_type add(component::base* c)
-    {
-      return components.add(c);
-    }
-
-    component::base*& get(om::id_type id)
-    {
-      return components.lookup(id);
-    }
-
-    void remove(om::id_type id)
-    {
-      delete components.lookup(id);
-      components.remove(id);
-    }
-
-    om::object_manager< component::base* >& get_data()
-    {
-      return components;
-    }
-
-    void shutdown()
-    {
-      for( auto c = components.begin(); c != components.end(); ++c )
-      {
-        delete c->second;
-      }
-    }
-  };
-
-  class manager
-  {
-    om::object_manager< base > entities; //collection of entities
-  private:
-  protected:
-    manager(){} //singleton
-    manager(const manager&);
-    manager(manager&&);
-    manager& operator=(const manager&);
-  public:
-    om::id_type add()
-    {
-      return entities.add(base());
-    }
-
-    base& get(om::id_type id)
-    {
-      return entities.lookup(id);
-    }
-
-    void remove(om::id_type id)
-    {
-      entities.remove(id);
-    }
-
-    om::object_manager< base >& get_data()
-    {
-      return entities;
-    }
-    
-    void shutdown()
-    {
-      for( auto c = entities.begin(); c != entities.end(); ++c )
-      {
-        c->second.shutdown();
-      }
-    }
-
-    static manager& get()
-    {
-      static manager instance;
-      return instance;
-    }
-  };
-}
-
-/*
- * Systems should contain all the logic to make components work
- * In this type of CES, systems don't hold the data (components), rather entitys hold them.
- */
-namespace system
-{
-  class base
-  {
-  public:
-    virtual void init(){}
-    virtual void shutdown(){}
-    virtual void update(){}
-    virtual om::id_type get_typeid(){return om::id_type();}
-  };
-
-  class pos : public base //there is a system for each component type
-  {
-    static om::id_type typ()
-    {
-      static char type;
-      return om::id_type(&type);
-    }
-  public:
-    static component::pos* create()
-    {
-      component::pos* c = new component::pos;
-      c->id = typ(); //add type information to a component
-      return c;
-    }
-
-    void init()
-    {
-      callback_manager::get().add_callback( [&]( callback_pack d )
-      {
-        if( d.type == EVENT_TYPE_TWO )
-        {
-          std::cout << "Event two: " << d.cbd.data << std::endl;
-          return true;
-        }
-
-        return false;
-      } );
-    }
-
-    void update()
-    {
-      for( auto c = ces::entity::manager::get().get_data().begin(); //go through all entities
-           c != ces::entity::manager::get().get_data().end(); ++c )
-      {
-        for( auto d = c->second.get_data().begin(); //go through all components
-             d != c->second.get_data().end(); ++d )
-        {
-          if(d->second->id == typ()) //if the type is the same
-          {
-            component::pos* p = static_cast<component::pos*>(d->second); //then cast the component to the right type
-            cout << p->x << " " << p->y << " " << p->z << endl; //and perform something on them
-
-            //send an event
-            callback_pack cbp;
-            cbp.type = EVENT_TYPE_ONE;
-            cbp.cbd.v4[0] = p->x;
-            cbp.cbd.v4[1] = p->y;
-            callback_manager::get().add_event( cbp );
-          }
-        }
-      }
-    }
-
-    om::id_type get_typeid()
-    {
-      return typ();
-    }
-  };
-
-  class name : public base
-  {
-    static om::id_type typ()
-    {
-      static char type;
-      return om::id_type(&type);
-    }
-  public:
-    static component::name* create()
-    {
-      component::name* c = new component::name;
-      c->id = typ();
-      return c;
-    }
-
-    void init()
-    {
-      callback_manager::get().add_callback( [&]( callback_pack d )
-      {
-        if( d.type == EVENT_TYPE_ONE )
-        {
-          std::cout << "Event one: " << d.cbd.v4[0] << " " << d.cbd.v4[1] << std::endl;
-          return true;
-        }
-
-        return false;
-      } );
-    }
-
-    void update()
-    {
-      for( auto c = ces::entity::manager::get().get_data().begin();
-           c != ces::entity::manager::get().get_data().end(); ++c )
-      {
-        for( auto d = c->second.get_data().begin();
-             d != c->second.get_data().end(); ++d )
-        {
-          if(d->second->id == typ())
-          {
-            component::name* p = static_cast<component::name*>(d->second);
-            cout << p->str.c_str() << endl;
-
-            //send an event
-            callback_pack cbp;
-            cbp.type = EVENT_TYPE_TWO;
-            memcpy( cbp.cbd.data, p->str.c_str(), p->str.size() + 1 );
-            callback_manager::get().add_event( cbp );
-          }
-        }
-      }
-    }
-
-    om::id_type get_typeid()
-    {
-      return typ();
-    }
-  };
-
-  //this is needed so that we can neatly just call tell this manager to update/init etc., 
-  //no need to know about the systems
-  class manager
-  {
-    list< base* > systems; 
-  private:
-  protected:
-    manager(){} //singleton
-    manager(const manager&);
-    manager(manager&&);
-    manager& operator=(const manager&);
-  public:
-    void add( base* c )
-    {
-      systems.push_back(c);
-    }
-
-    void update()
-    {
-      for( auto c = systems.begin(); c != systems.end(); ++c )
-        (*c)->update();
-    }
-
-    void init()
-    {
-      for( auto c = systems.begin(); c != systems.end(); ++c )
-        (*c)->init();
-    }
-
-    void shutdown()
-    {
-      //destroy in reverse order
-      for( auto c = systems.rbegin(); c != systems.rend(); ++c )
-      {
-        (*c)->shutdown();
-        delete *c;
-      }
-    }
-
-    static manager& get()
-    {
-      static manager instance;
-      return instance;
-    }
-  };
-}
-}
-
-//usage
-int main()
-{
-  ces::system::manager::get().add(new ces::system::pos);
-  ces::system::manager::get().add(new ces::system::name);
-
-  om::id_type entity_with_pos = ces::entity::manager::get().add();
-  auto pos_component1 = ces::system::pos::create();
-  pos_component1->x = 1;
-  pos_component1->y = 2;
-  pos_component1->z = 3;
-  ces::entity::manager::get().get(entity_with_pos).add(pos_component1);
-
-  om::id_type entity_with_name = ces::entity::manager::get().add();
-  auto name_component1 = ces::system::name::create();
-  name_component1->str = "hello world";
-  ces::entity::manager::get().get(entity_with_name).add(name_component1);
-
-  om::id_type entity_with_pos_and_name = ces::entity::manager::get().add();
-  auto pos_component2 = ces::system::pos::create();
-  pos_component2->x = 4;
-  pos_component2->y = 5;
-  pos_component2->z = 6;
-  auto name_component2 = ces::system::name::create();
-  name_component2->str = "world hello lolwut?";
-  ces::entity::manager::get().get(entity_with_pos_and_name).add(pos_component2);
-  ces::entity::manager::get().get(entity_with_pos_and_name).add(name_component2);
-
-  ces::system::manager::get().init();
-  ces::system::manager::get().update();
-  ces::callback_manager::get().dispatch_callbacks();
-  ces::system::manager::get().shutdown();
-
-  ces::entity::manager::get().shutdown();
-
-  writeout_bits(entity_with_pos);
-
-	cin.get();
-	return 0;
-}
-
+#include <iostream>
+#include <list>
+#include <vector>
+#include <cassert>
+
+#include "object_manager.h"
+#include "ces_callback.h"
+#include "ces_scheduler.h"
+#include "ces_command_buffer.h"
+#include "object_pool.h"
+#include "ces_profiler.h"
+#include "component_singleton.h"
+#include "ces_string_pool.h"
+
+#ifdef CES_BENCHMARK
+#include "bench/bench.h"
+#endif
+
+#ifndef USE_TYPE_A
+#define USE_TYPE_A
+#endif
+#ifdef USE_TYPE_A
+
+/*
+ * CES SYSTEM IMPLEMENTATION "A"
+ *
+ * In type A:
+ * Systems are separate, they only contain logic, no data. They are wrapped around by a system-manager.
+ * Entities are stored in an entity-manager.
+ * Each entity contains a vector of components, and an ID that identifies the entity.
+ * Each entity keeps a signature, a bit for each component type it has.
+ * Each component type keeps a match list of the components whose entity has everything the type's system needs,
+ * it is updated when components are added or removed, so systems only visit their own components on update.
+ * Tags are components without data, they are only a bit in the signature, so testing for one is a bit test.
+ * Note that entities and components don't store their ID directly, they are rather just identified by systems and other objects by it.
+ *
+ * System Manager
+ *   -Systems
+ *     -type-id
+ *
+ * Entity manager
+ *   -Entites
+ *     -ID
+ *     -Components
+ *       -ID
+ *       -type-id
+ *       -data
+ *     -signature
+ *
+ * Component types
+ *   -pool
+ *   -signature bit
+ *   -match list
+ */
+
+using namespace std;
+
+enum
+{
+  EVENT_TYPE_ONE, EVENT_TYPE_TWO
+};
+
+/*
+ * Components only contain data, no logic (only constructors/destructors maybe)
+ */
+namespace ces
+{
+namespace component
+{
+  class base
+  {
+  public:
+    om::id_type id; //type id, assigned by a system. It's the address of the type's record
+    unsigned slot; //position in the type's match list, or unmatched
+    base() : slot(unmatched) {}
+    static const unsigned unmatched = ~0u;
+  };
+
+  typedef om::pool_base< base > pool_base;
+  typedef unsigned long long signature; //one bit per component type or tag, so at most 64 of them
+
+  inline unsigned next_bit()
+  {
+    static unsigned count = 0;
+    assert(count < 64 && "a signature holds at most 64 component types and tags");
+    return count++;
+  }
+
+  //a marker like "static", entities only get its bit in their signature, there is no data
+  class tag
+  {
+  public:
+    unsigned bit;
+
+    signature mask() const
+    {
+      return signature(1) << bit;
+    }
+
+    tag() : bit(next_bit()) {}
+  };
+
+  //everything entities need to know about a component type
+  class type
+  {
+    static vector< type* >& types()
+    {
+      static vector< type* > instance;
+      return instance;
+    }
+  public:
+    pool_base* pool; //where components of this type are allocated from
+    unsigned bit; //bit in entity signatures
+    signature requires; //what an entity needs for its component of this type to be matched
+    signature excludes; //what it mustn't have, eg. tags the system skips
+    vector< base* > matches; //the components the system of this type processes
+
+    void match(base* c)
+    {
+      if( c->slot == base::unmatched )
+      {
+        c->slot = matches.size();
+        matches.push_back(c);
+      }
+    }
+
+    void unmatch(base* c)
+    {
+      if( c->slot != base::unmatched )
+      {
+        matches[c->slot] = matches.back();
+        matches[c->slot]->slot = c->slot;
+        matches.pop_back();
+        c->slot = base::unmatched;
+      }
+    }
+
+    //forgets every match, for when all components are released at once
+    static void clear_all_matches()
+    {
+      for( auto c = types().begin(); c != types().end(); ++c )
+        (*c)->matches.clear();
+    }
+
+    type(pool_base* p, signature skip = 0) : pool(p), bit(next_bit()), excludes(skip)
+    {
+      requires = signature(1) << bit;
+      types().push_back(this);
+    }
+  };
+
+  inline type& type_of(base* c)
+  {
+    return *reinterpret_cast< type* >(c->id);
+  }
+
+  //gives a component back to the pool it was created from
+  inline void release(base* c)
+  {
+    type_of(c).pool->release(c);
+  }
+
+  class pos : public base
+  {
+  public:
+    float x, y, z;
+    pos(float a = float(), float b = float(), float c = float()) : x(a), y(b), z(c) {}
+  };
+
+  class name : public base
+  {
+  public:
+    symbol str; //interned, see string_pool
+    name(const char* n = "") : str(string_pool::get().intern(n)) {}
+
+    const char* c_str() const
+    {
+      return string_pool::get().str(str);
+    }
+  };
+
+  //entities that don't move
+  inline tag& is_static()
+  {
+    static tag instance;
+    return instance;
+  }
+
+  //a singleton, there is one per world
+  struct frame
+  {
+    unsigned number; //frames updated so far
+    frame() : number(0) {}
+  };
+}
+
+/*
+ * Entities. In this type, they hold all the data, but no logic, systems process them.
+ */
+namespace entity
+{
+  class base
+  {
+    om::object_manager< component::base* > components; //collection of components
+    component::signature sig; //a bit for each component type and tag the entity has
+    component::signature tags;
+
+    //recomputes the signature, and puts the components into or out of their match lists
+    void refresh()
+    {
+      sig = tags;
+      for( auto c = components.begin(); c != components.end(); ++c )
+        sig |= component::signature(1) << component::type_of(c->second).bit;
+
+      for( auto c = components.begin(); c != components.end(); ++c )
+      {
+        component::type& t = component::type_of(c->second);
+        if( ( sig & t.requires ) == t.requires && !( sig & t.excludes ) )
+          t.match(c->second);
+        else
+          t.unmatch(c->second);
+      }
+    }
+  public:
+    om::id_type add(component::base* c)
+    {
+      om::id_type id = components.add(c);
+      refresh();
+      return id;
+    }
+
+    component::base*& get(om::id_type id)
+    {
+      return components.lookup(id);
+    }
+
+    void remove(om::id_type id)
+    {
+      component::base* c = components.lookup(id);
+      component::type_of(c).unmatch(c);
+      component::release(c);
+      components.remove(id);
+      refresh();
+    }
+
+    void add_tag(const component::tag& t)
+    {
+      tags |= t.mask();
+      refresh();
+    }
+
+    void remove_tag(const component::tag& t)
+    {
+      tags &= ~t.mask();
+      refresh();
+    }
+
+    bool has_tag(const component::tag& t)
+    {
+      return ( sig & t.mask() ) != 0;
+    }
+
+    component::signature get_signature()
+    {
+      return sig;
+    }
+
+    base() : sig(0), tags(0) {}
+
+    om::object_manager< component::base* >& get_data()
+    {
+      return components;
+    }
+
+    void shutdown()
+    {
+      for( auto c = components.begin(); c != components.end(); ++c )
+      {
+        component::type_of(c->second).unmatch(c->second);
+        component::release(c->second);
+      }
+    }
+  };
+
+  class manager
+  {
+    om::object_manager< base > entities; //collection of entities
+    om::singleton_store world; //singleton components
+  private:
+  protected:
+    manager(){} //singleton
+    manager(const manager&);
+    manager(manager&&);
+    manager& operator=(const manager&);
+  public:
+    om::id_type add()
+    {
+      return entities.add(base());
+    }
+
+    base& get(om::id_type id)
+    {
+      return entities.lookup(id);
+    }
+
+    void remove(om::id_type id)
+    {
+      entities.lookup(id).shutdown(); //give its components back
+      entities.remove(id);
+    }
+
+    //creates count entities at once, their ids are written to out
+    void add_n(size_t count, om::id_type* out)
+    {
+      entities.add_n(count, base(), out);
+    }
+
+    void remove_n(const om::id_type* ids, size_t count)
+    {
+      for( size_t c = 0; c < count; ++c )
+        entities.lookup(ids[c]).shutdown();
+      entities.remove_n(ids, count);
+    }
+
+    om::object_manager< base >& get_data()
+    {
+      return entities;
+    }
+
+    //the world's one t, made on first use
+    template< class t >
+    t& singleton()
+    {
+      return world.get< t >();
+    }
+    
+    void shutdown()
+    {
+      //drop the entities first, so no handle is left pointing at a released component
+      vector< om::id_type > ids;
+      for( auto c = entities.begin(); c != entities.end(); ++c )
+        ids.push_back(c->first);
+      entities.remove_n(ids.data(), ids.size());
+
+      //every component comes from a pool, so they can all be released at once
+      component::pool_base::release_all_pools();
+      component::type::clear_all_matches();
+    }
+
+    static manager& get()
+    {
+      static manager instance;
+      return instance;
+    }
+  };
+}
+
+//structural changes recorded during update(), applied when every system is done
+typedef command_buffer< entity::manager > commands;
+
+/*
+ * Systems should contain all the logic to make components work
+ * In this type of CES, systems don't hold the data (components), rather entitys hold them.
+ */
+namespace system
+{
+  class base
+  {
+  public:
+    virtual void init(){}
+    virtual void shutdown(){}
+    virtual void update(){}
+    virtual om::id_type get_typeid(){return om::id_type();}
+    virtual const char* get_name(){ return "system"; } //shows up in the profiler
+    virtual ~base(){}
+    virtual void declare_access(access&){} //what update() touches, nothing declared means everything
+  };
+
+  class pos : public base //there is a system for each component type
+  {
+    //components of this type are allocated from here
+    static om::pool< component::pos, component::base >& storage()
+    {
+      static om::pool< component::pos, component::base > instance;
+      return instance;
+    }
+
+    //the type's record, its match list holds the components update() processes
+    //static entities are left out
+    static component::type& info()
+    {
+      static component::type instance(&storage(), component::is_static().mask());
+      return instance;
+    }
+
+    static om::id_type typ()
+    {
+      return om::id_type(&info());
+    }
+  public:
+    static component::pos* create()
+    {
+      component::pos* c = storage().create();
+      c->id = typ(); //add type information to a component
+      return c;
+    }
+
+    void init()
+    {
+      callback_manager::get().add_callback( EVENT_TYPE_TWO, [&]( const callback_pack& d )
+      {
+        std::cout << "Event two: " << string_pool::get().str(d.cbd.v4[0]) << std::endl;
+        return true;
+      } );
+    }
+
+    void update()
+    {
+      auto& matches = info().matches;
+      for( auto c = matches.begin(); c != matches.end(); ++c ) //go through the matched components only
+      {
+        component::pos* p = static_cast<component::pos*>(*c); //they are all of the right type
+        cout << p->x << " " << p->y << " " << p->z << endl; //perform something on them
+
+        //send an event
+        callback_pack cbp;
+        cbp.type = EVENT_TYPE_ONE;
+        cbp.cbd.v4[0] = p->x;
+        cbp.cbd.v4[1] = p->y;
+        callback_manager::get().add_event( cbp );
+      }
+    }
+
+    om::id_type get_typeid()
+    {
+      return typ();
+    }
+
+    const char* get_name()
+    {
+      return "pos";
+    }
+
+    void declare_access(access& a)
+    {
+      a.read< component::pos >();
+      a.write< std::ostream >(); //printing, events can be raised from any thread
+    }
+  };
+
+  class name : public base
+  {
+    //components of this type are allocated from here
+    static om::pool< component::name, component::base >& storage()
+    {
+      static om::pool< component::name, component::base > instance;
+      return instance;
+    }
+
+    //the type's record, its match list holds the components update() processes
+    static component::type& info()
+    {
+      static component::type instance(&storage());
+      return instance;
+    }
+
+    static om::id_type typ()
+    {
+      return om::id_type(&info());
+    }
+  public:
+    static component::name* create()
+    {
+      component::name* c = storage().create();
+      c->id = typ();
+      return c;
+    }
+
+    void init()
+    {
+      callback_manager::get().add_callback( EVENT_TYPE_ONE, [&]( const callback_pack& d )
+      {
+        std::cout << "Event one: " << d.cbd.v4[0] << " " << d.cbd.v4[1] << std::endl;
+        return true;
+      } );
+    }
+
+    void update()
+    {
+      auto& matches = info().matches;
+      for( auto c = matches.begin(); c != matches.end(); ++c )
+      {
+        component::name* p = static_cast<component::name*>(*c);
+        cout << p->c_str() << endl;
+
+        //send an event
+        callback_pack cbp;
+        cbp.type = EVENT_TYPE_TWO;
+        cbp.cbd.v4[0] = p->str; //the symbol, the text stays in the pool
+        callback_manager::get().add_event( cbp );
+      }
+    }
+
+    om::id_type get_typeid()
+    {
+      return typ();
+    }
+
+    const char* get_name()
+    {
+      return "name";
+    }
+
+    void declare_access(access& a)
+    {
+      a.read< component::name >();
+      a.write< std::ostream >(); //printing, events can be raised from any thread
+    }
+  };
+
+  //this is needed so that we can neatly just call tell this manager to update/init etc., 
+  //no need to know about the systems
+  class manager
+  {
+    list< base* > systems; 
+    vector< base* > order; //systems in the order the schedule was built for
+    scheduler schedule;
+  private:
+  protected:
+    manager(){} //singleton
+    manager(const manager&);
+    manager(manager&&);
+    manager& operator=(const manager&);
+  public:
+    void add( base* c )
+    {
+      systems.push_back(c);
+      order.clear(); //reschedule on the next update
+    }
+
+    //systems that don't conflict run in parallel, the others in the order they were added
+    void update()
+    {
+      CES_PROFILE_SCOPE("update");
+
+      entity::manager::get().singleton< component::frame >().number++;
+
+      if( order.empty() )
+      {
+        vector< access > accesses( systems.size() );
+        for( auto c = systems.begin(); c != systems.end(); ++c )
+        {
+          (*c)->declare_access( accesses[order.size()] );
+          order.push_back( *c );
+        }
+
+        schedule.build( accesses );
+      }
+
+      schedule.run( [this]( size_t i )
+      {
+        CES_PROFILE_SCOPE( order[i]->get_name() );
+        order[i]->update();
+      } );
+
+      //sync point, nothing iterates anymore
+      commands::get().flush( entity::manager::get() );
+    }
+
+    void init()
+    {
+      for( auto c = systems.begin(); c != systems.end(); ++c )
+        (*c)->init();
+    }
+
+    void shutdown()
+    {
+      //destroy in reverse order
+      for( auto c = systems.rbegin(); c != systems.rend(); ++c )
+      {
+        (*c)->shutdown();
+        delete *c;
+      }
+    }
+
+    static manager& get()
+    {
+      static manager instance;
+      return instance;
+    }
+  };
+}
+}
+
+#ifdef CES_BENCHMARK
+//the benchmark's view of this type, see bench/bench.h
+namespace
+{
+  class engine : public bench::engine
+  {
+    ces::component::type* pos_type;
+    ces::component::type* name_type;
+    size_t handled;
+
+    static const unsigned event_type = EVENT_TYPE_TWO + 1;
+  public:
+    const char* name()
+    {
+      return "type_a";
+    }
+
+    void create(om::id_type* ids, size_t count)
+    {
+      auto& em = ces::entity::manager::get();
+      em.add_n(count, ids);
+
+      for( size_t c = 0; c < count; ++c )
+      {
+        auto& e = em.get(ids[c]);
+
+        auto p = ces::system::pos::create();
+        p->x = float(c);
+        e.add(p);
+        pos_type = &ces::component::type_of(p);
+
+        if( c % 2 == 0 )
+        {
+          auto n = ces::system::name::create();
+          n->str = ces::string_pool::get().intern("entity");
+          e.add(n);
+          name_type = &ces::component::type_of(n);
+        }
+      }
+    }
+
+    void destroy(const om::id_type* ids, size_t count)
+    {
+      ces::entity::manager::get().remove_n(ids, count);
+      ces::entity::manager::get().shutdown(); //hand the pool blocks back
+    }
+
+    double iterate()
+    {
+      double sum = 0;
+      auto& matches = pos_type->matches;
+      for( auto c = matches.begin(); c != matches.end(); ++c )
+        sum += static_cast< ces::component::pos* >(*c)->x;
+      return sum;
+    }
+
+    double lookup(const om::id_type* ids, size_t count)
+    {
+      double sum = 0;
+      for( size_t c = 0; c < count; ++c )
+      {
+        auto& components = ces::entity::manager::get().get(ids[c]).get_data();
+        for( auto d = components.begin(); d != components.end(); ++d )
+        {
+          if( &ces::component::type_of(d->second) == pos_type )
+          {
+            sum += static_cast< ces::component::pos* >(d->second)->x;
+            break;
+          }
+        }
+      }
+      return sum;
+    }
+
+    size_t join()
+    {
+      ces::component::signature both = ( ces::component::signature(1) << pos_type->bit ) | ( ces::component::signature(1) << name_type->bit );
+      size_t count = 0;
+
+      auto& entities = ces::entity::manager::get().get_data();
+      for( auto c = entities.begin(); c != entities.end(); ++c )
+      {
+        if( ( c->second.get_signature() & both ) != both )
+          continue;
+
+        ces::component::pos* p = 0;
+        ces::component::name* n = 0;
+        auto& components = c->second.get_data();
+        for( auto d = components.begin(); d != components.end(); ++d )
+        {
+          if( &ces::component::type_of(d->second) == pos_type )
+            p = static_cast< ces::component::pos* >(d->second);
+          else if( &ces::component::type_of(d->second) == name_type )
+            n = static_cast< ces::component::name* >(d->second);
+        }
+
+        count += p && n && n->str != ces::string_pool::empty;
+      }
+      return count;
+    }
+
+    size_t dispatch(size_t count)
+    {
+      if( handled == size_t(-1) )
+      {
+        handled = 0;
+        ces::callback_manager::get().add_callback( event_type, [this]( const ces::callback_pack& )
+        {
+          ++handled;
+          return true;
+        } );
+      }
+
+      size_t before = handled;
+      ces::callback_pack cbp;
+      cbp.type = event_type;
+      for( size_t c = 0; c < count; ++c )
+      {
+        cbp.cbd.v4[0] = unsigned(c);
+        ces::callback_manager::get().add_event(cbp);
+      }
+      ces::callback_manager::get().dispatch_callbacks();
+      return handled - before;
+    }
+
+    engine() : pos_type(0), name_type(0), handled(size_t(-1)) {}
+  };
+
+  bench::registrar registered(new engine);
+}
+#else
+//usage
+int main()
+{
+  ces::system::manager::get().add(new ces::system::pos);
+  ces::system::manager::get().add(new ces::system::name);
+
+  om::id_type entity_with_pos = ces::entity::manager::get().add();
+  auto pos_component1 = ces::system::pos::create();
+  pos_component1->x = 1;
+  pos_component1->y = 2;
+  pos_component1->z = 3;
+  ces::entity::manager::get().get(entity_with_pos).add(pos_component1);
+
+  om::id_type entity_with_name = ces::entity::manager::get().add();
+  auto name_component1 = ces::system::name::create();
+  name_component1->str = ces::string_pool::get().intern("hello world");
+  ces::entity::manager::get().get(entity_with_name).add(name_component1);
+
+  om::id_type entity_with_pos_and_name = ces::entity::manager::get().add();
+  auto pos_component2 = ces::system::pos::create();
+  pos_component2->x = 4;
+  pos_component2->y = 5;
+  pos_component2->z = 6;
+  auto name_component2 = ces::system::name::create();
+  name_component2->str = ces::string_pool::get().intern("world hello lolwut?");
+  ces::entity::manager::get().get(entity_with_pos_and_name).add(pos_component2);
+  ces::entity::manager::get().get(entity_with_pos_and_name).add(name_component2);
+
+  //tags are only a signature bit, the pos system skips static entities
+  om::id_type static_entity = ces::entity::manager::get().add();
+  auto pos_component3 = ces::system::pos::create();
+  pos_component3->x = 7;
+  ces::entity::manager::get().get(static_entity).add(pos_component3);
+  ces::entity::manager::get().get(static_entity).add_tag(ces::component::is_static());
+
+  ces::system::manager::get().init();
+  ces::system::manager::get().update();
+  ces::callback_manager::get().dispatch_callbacks();
+  cout << "frames: " << ces::entity::manager::get().singleton< ces::component::frame >().number << endl;
+  ces::system::manager::get().shutdown();
+
+  ces::entity::manager::get().shutdown();
+
+#ifdef CES_PROFILE
+  //what each system, the dispatch and the flush cost, open trace.json in chrome://tracing for the timeline
+  ces::profiler::get().each_stats( []( const char* name, const ces::profile_stats& s )
+  {
+    cout << name << ": " << s.count << " runs, min " << s.min << " avg " << s.avg << " p99 " << s.p99 << " us" << endl;
+  } );
+  ces::profiler::get().save_chrome_trace("trace.json");
+#endif
+
+  writeout_bits(entity_with_pos);
+
+	cin.get();
+	return 0;
+}
+#endif
+
 #endif
\ No newline at end of file
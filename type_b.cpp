@@ -1,271 +1,893 @@
-#include <iostream>
-#include <list>
-
-#include "object_manager.h"
-
-//#define USE_TYPE_B
-#ifdef USE_TYPE_B
-
-/*
- * CES SYSTEM IMPLEMENTATION "B"
- * 
- * In type B:
- * Systems are separate, each contain the components they act on.
- * They are wrapped around by a system-manager.
- * Entities are stored in and entity-manager.
- * Each entity contains an ID that identifies which components belong to it.
- * Therefore finding each component of an entity takes a bit longer, but each component's type is 'known'
- * 
- * System Manager
- *   -Systems
- *     -Components
- *       -ID
- *       -entity-id
- *       -data
- *     -type-id
- * 
- * Entity manager
- *   -Entites
- *     -ID
- */
-
-using namespace std;
-
-/*
- * Components only contain data, no logic (only constructors/destructors maybe)
- */
-namespace ces
-{
-namespace component
-{
-  class base
-  {
-  public:
-    om::id_type id; //entity id, assigned by a system
-  };
-
-  class pos : public base
-  {
-  public:
-    float x, y, z;
-    pos(float a = float(), float b = float(), float c = float()) : x(a), y(b), z(c) {}
-  };
-
-  class name : public base
-  {
-  public:
-    string str;
-    name(const string& n = string()) : str(n) {}
-  };
-}
-
-/*
- * Entities. In this type, they don't hold any data or logic, only an ID.
- */
-namespace entity
-{
-  class base
-  {
-  public:
-    om::id_type id;
-  };
-
-  class manager
-  {
-    om::object_manager< base > entities; //collection of entities
-  private:
-  protected:
-    manager(){} //singleton
-    manager(const manager&);
-    manager(manager&&);
-    manager& operator=(const manager&);
-  public:
-    om::id_type add()
-    {
-      return entities.add(base());
-    }
-
-    base& get(om::id_type id)
-    {
-      return entities.lookup(id);
-    }
-
-    void remove(om::id_type id)
-    {
-      entities.remove(id);
-    }
-
-    om::object_manager< base >& get_data()
-    {
-      return entities;
-    }
-
-    static manager& get()
-    {
-      static manager instance;
-      return instance;
-    }
-  };
-}
-
-/*
- * In this type of CES, systems hold the data (components).
- */
-namespace system
-{
-  class base
-  {
-  public:
-    virtual void init(){}
-    virtual void shutdown(){}
-    virtual void update(){}
-    //no need for type IDs
-  };
-
-  class pos : public base //there is a system for each component type
-  {
-    om::object_manager< component::pos > components;
-  public:
-    om::id_type add(om::id_type entity_id)
-    {
-      auto tmp = components.add(component::pos());
-      components.lookup(tmp).id = entity_id;
-      return tmp;
-    }
-
-    component::pos& get(om::id_type id)
-    {
-      return components.lookup(id);
-    }
-
-    void remove(om::id_type id)
-    {
-      components.remove(id);
-    }
-
-    void update()
-    {
-      for( auto c = components.begin(); c != components.end(); ++c )
-      {
-        cout << c->second.x << " " << c->second.y << " " << c->second.z << endl; //perform something on them
-      }
-    }
-  };
-
-  class name : public base
-  {
-    om::object_manager< component::name > components;
-  public:
-    om::id_type add(om::id_type entity_id)
-    {
-      auto tmp = components.add(component::name());
-      components.lookup(tmp).id = entity_id;
-      return tmp;
-    }
-
-    component::name& get(om::id_type id)
-    {
-      return components.lookup(id);
-    }
-
-    void remove(om::id_type id)
-    {
-      components.remove(id);
-    }
-
-    void update()
-    {
-      for( auto c = components.begin(); c != components.end(); ++c )
-      {
-        cout << c->second.str.c_str() << endl;
-      }
-    }
-  };
-
-  //this is needed so that we can neatly just call tell this manager to update/init etc., 
-  //no need to know about the systems
-  class manager
-  {
-    list< base* > systems; 
-  private:
-  protected:
-    manager(){} //singleton
-    manager(const manager&);
-    manager(manager&&);
-    manager& operator=(const manager&);
-  public:
-    void add( base* c )
-    {
-      systems.push_back(c);
-    }
-
-    void update()
-    {
-      for( auto c = systems.begin(); c != systems.end(); ++c )
-        (*c)->update();
-    }
-
-    void init()
-    {
-      for( auto c = systems.begin(); c != systems.end(); ++c )
-        (*c)->init();
-    }
-
-    void shutdown()
-    {
-      //destroy in reverse order
-      for( auto c = systems.rbegin(); c != systems.rend(); ++c )
-      {
-        (*c)->shutdown();
-        delete *c;
-      }
-    }
-
-    static manager& get()
-    {
-      static manager instance;
-      return instance;
-    }
-  };
-}
-}
-
-//usage
-int main()
-{
-  auto pos_sys = new ces::system::pos; //systems will either need to be stored in a map, or kept around to access them
-  auto name_sys = new ces::system::name;
-  ces::system::manager::get().add(pos_sys);
-  ces::system::manager::get().add(name_sys);
-
-  om::id_type entity_with_pos = ces::entity::manager::get().add();
-  om::id_type pos_component1 = pos_sys->add(entity_with_pos);
-  auto& pc1 = pos_sys->get(pos_component1);
-  pc1.x = 1;
-  pc1.y = 2;
-  pc1.z = 3;
-
-  om::id_type entity_with_name = ces::entity::manager::get().add();
-  om::id_type name_component1 = name_sys->add(entity_with_name);
-  auto& nc1 = name_sys->get(name_component1);
-  nc1.str = "hello world";
-
-  om::id_type entity_with_pos_and_name = ces::entity::manager::get().add();
-  om::id_type pos_component2 = pos_sys->add(entity_with_pos_and_name);
-  auto& pc2 = pos_sys->get(pos_component2);
-  pc2.x = 4;
-  pc2.y = 5;
-  pc2.z = 6;
-  om::id_type name_component2 = name_sys->add(entity_with_pos_and_name);
-  auto& nc2 = name_sys->get(name_component2);
-  nc2.str = "world hello lolwut?";
-
-  ces::system::manager::get().init();
-  ces::system::manager::get().update();
-  ces::system::manager::get().shutdown();
-
-	cin.get();
-	return 0;
-}
-
+#include <iostream>
+#include <list>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+#include "object_manager.h"
+#include "component_store.h"
+#include "component_view.h"
+#include "ces_scheduler.h"
+#include "ces_command_buffer.h"
+#include "ces_parallel.h"
+#include "object_sort.h"
+#include "object_snapshot.h"
+#include "object_delta.h"
+#include "component_reactive.h"
+#include "component_spatial.h"
+#include "component_tag.h"
+#include "component_singleton.h"
+#include "component_hierarchy.h"
+#include "component_name_index.h"
+#include "ces_string_pool.h"
+#include "ces_profiler.h"
+
+#ifdef CES_BENCHMARK
+#include "bench/bench.h"
+#endif
+
+//#define USE_TYPE_B
+#ifdef USE_TYPE_B
+
+/*
+ * CES SYSTEM IMPLEMENTATION "B"
+ * 
+ * In type B:
+ * Systems are separate, each contain the components they act on.
+ * They are wrapped around by a system-manager.
+ * Entities are stored in and entity-manager.
+ * Each entity contains an ID that identifies which components belong to it.
+ * Therefore finding each component of an entity takes a bit longer, but each component's type is 'known'
+ * 
+ * System Manager
+ *   -Systems
+ *     -Components
+ *       -ID
+ *       -entity-id
+ *       -data
+ *     -type-id
+ * 
+ * Entity manager
+ *   -Entites
+ *     -ID
+ */
+
+using namespace std;
+
+/*
+ * Components only contain data, no logic (only constructors/destructors maybe)
+ */
+namespace ces
+{
+//sections of a saved world
+enum snapshot_tag
+{
+  snapshot_entities, snapshot_pos, snapshot_name, snapshot_transform
+};
+
+namespace component
+{
+  class base
+  {
+  public:
+    om::id_type id; //entity id, assigned by a system
+  };
+
+  class pos : public base
+  {
+  public:
+    float x, y, z;
+    pos(float a = float(), float b = float(), float c = float()) : x(a), y(b), z(c) {}
+  };
+
+  class name : public base
+  {
+  public:
+    symbol str; //interned, see string_pool
+    name(const char* n = "") : str(string_pool::get().intern(n)) {}
+
+    const char* c_str() const
+    {
+      return string_pool::get().str(str);
+    }
+  };
+
+  //how a name is saved, the string goes to the snapshot's string table
+  struct name_record
+  {
+    om::id_type id;
+    uint32_t str;
+  };
+
+  //a tag, entities are either selected or not, there is no data (see om::tag_store)
+  struct selected {};
+
+  //a singleton, there is one per world
+  struct frame
+  {
+    unsigned number; //frames updated so far
+    frame() : number(0) {}
+  };
+}
+
+/*
+ * Entities. In this type, they don't hold any data or logic, only an ID.
+ */
+namespace entity
+{
+  class base
+  {
+  public:
+    om::id_type id;
+  };
+
+  //told about every entity that is removed, so whatever refers to it can let go
+  class removal_listener
+  {
+  public:
+    virtual void on_remove(om::id_type entity_id) = 0;
+    virtual ~removal_listener(){}
+  };
+
+  class manager
+  {
+    om::object_manager< base > entities; //collection of entities
+    om::singleton_store world; //singleton components and tag sets
+    vector< om::tag_base* > tag_sets; //they forget the entities that are removed
+    vector< removal_listener* > listeners;
+
+    void removed(om::id_type id)
+    {
+      for( auto c = tag_sets.begin(); c != tag_sets.end(); ++c )
+        (*c)->remove(id);
+      for( auto c = listeners.begin(); c != listeners.end(); ++c )
+        (*c)->on_remove(id);
+    }
+  private:
+  protected:
+    manager(){} //singleton
+    manager(const manager&);
+    manager(manager&&);
+    manager& operator=(const manager&);
+  public:
+    om::id_type add()
+    {
+      om::id_type id = entities.add(base());
+      entities.lookup(id).id = id;
+      return id;
+    }
+
+    base& get(om::id_type id)
+    {
+      return entities.lookup(id);
+    }
+
+    void remove(om::id_type id)
+    {
+      removed(id);
+      entities.remove(id);
+    }
+
+    //creates count entities at once, their ids are written to out
+    void add_n(size_t count, om::id_type* out)
+    {
+      entities.add_n(count, base(), out);
+      for( size_t c = 0; c < count; ++c )
+        entities.lookup(out[c]).id = out[c];
+    }
+
+    void remove_n(const om::id_type* ids, size_t count)
+    {
+      for( size_t c = 0; c < count; ++c )
+        removed(ids[c]);
+      entities.remove_n(ids, count);
+    }
+
+    //the world's one t, made on first use
+    template< class t >
+    t& singleton()
+    {
+      return world.get< t >();
+    }
+
+    //the entities tagged with t, made on first use
+    template< class t >
+    om::tag_store< t >& tags()
+    {
+      if( !world.has< om::tag_store< t > >() )
+        tag_sets.push_back(&world.get< om::tag_store< t > >());
+      return world.get< om::tag_store< t > >();
+    }
+
+    //l is told about every entity removed, until it is taken off
+    void add_listener(removal_listener* l)
+    {
+      listeners.push_back(l);
+    }
+
+    void remove_listener(removal_listener* l)
+    {
+      listeners.erase(std::find(listeners.begin(), listeners.end(), l));
+    }
+
+    om::object_manager< base >& get_data()
+    {
+      return entities;
+    }
+
+    void save(om::snapshot_writer& w)
+    {
+      w.write(snapshot_entities, entities);
+    }
+
+    bool load(om::snapshot& s)
+    {
+      return s.load(snapshot_entities, entities);
+    }
+
+    static manager& get()
+    {
+      static manager instance;
+      return instance;
+    }
+  };
+}
+
+//structural changes recorded during update(), applied when every system is done
+typedef command_buffer< entity::manager > commands;
+
+/*
+ * In this type of CES, systems hold the data (components).
+ */
+namespace system
+{
+  class base
+  {
+  public:
+    virtual void init(){}
+    virtual void shutdown(){}
+    virtual void update(){}
+    //no need for type IDs
+    virtual void declare_access(access&){} //what update() touches, nothing declared means everything
+    virtual void save(om::snapshot_writer&){}
+    virtual bool load(om::snapshot&){ return true; }
+    virtual const char* get_name(){ return "system"; } //shows up in the profiler
+    virtual ~base(){}
+  };
+
+  class pos : public base //there is a system for each component type
+  {
+    typedef om::reactive< om::component_store< component::pos > > reactive;
+
+    om::component_store< component::pos > components;
+    reactive moved; //only what changed since the last update
+  public:
+    typedef om::spatial_grid< om::component_store< component::pos > > spatial_index;
+  private:
+    std::unique_ptr< spatial_index > nearby; //only if someone asked for it
+  public:
+    pos() : moved(components, reactive::on_added | reactive::on_changed | reactive::on_removed) {}
+
+    om::id_type add(om::id_type entity_id)
+    {
+      return components.add(entity_id);
+    }
+
+    component::pos& get(om::id_type id)
+    {
+      return components.lookup(id);
+    }
+
+    void remove(om::id_type id)
+    {
+      components.remove(id);
+    }
+
+    bool has_for_entity(om::id_type entity_id)
+    {
+      return components.has_for_entity(entity_id);
+    }
+
+    component::pos& get_for_entity(om::id_type entity_id)
+    {
+      return components.get_for_entity(entity_id);
+    }
+
+    om::component_store< component::pos >& get_data()
+    {
+      return components;
+    }
+
+    //builds a spatial index over the positions, update() keeps it current
+    void index_space(float cell_size)
+    {
+      nearby.reset(new spatial_index(components, cell_size));
+    }
+
+    //0 unless index_space() was called
+    spatial_index* get_spatial_index()
+    {
+      return nearby.get();
+    }
+
+    void declare_access(access& a)
+    {
+      //reading the reactive and the spatial index commits the store's change log
+      a.write< component::pos >().write< std::ostream >();
+    }
+
+    const char* get_name()
+    {
+      return "pos";
+    }
+
+    void save(om::snapshot_writer& w)
+    {
+      w.write(snapshot_pos, components.get_data());
+    }
+
+    bool load(om::snapshot& s)
+    {
+      if( !s.load(snapshot_pos, components.get_data()) )
+        return false;
+
+      components.rebuild_index();
+      if( nearby ) //loading isn't a change, the index has to start over
+        index_space(nearby->get_cell_size());
+      return true;
+    }
+
+    void update()
+    {
+      if( nearby )
+        nearby->update();
+
+      moved.each([](om::id_type, const component::pos& p)
+      {
+        cout << p.x << " " << p.y << " " << p.z << endl; //perform something on them
+      },
+      [](om::id_type entity_id)
+      {
+        cout << "entity " << entity_id << " lost its position" << endl;
+      });
+    }
+  };
+
+  class name : public base
+  {
+    typedef om::reactive< om::component_store< component::name > > reactive;
+
+    om::component_store< component::name > components;
+    reactive renamed; //keeps the index up to date
+    om::name_index by_name;
+
+    void rebuild_by_name()
+    {
+      by_name.clear();
+      for( auto c = components.begin(); c != components.end(); ++c )
+        by_name.add(c->second.id, c->second.str);
+    }
+  public:
+    name() : renamed(components, reactive::on_added | reactive::on_changed | reactive::on_removed) {}
+
+    om::id_type add(om::id_type entity_id)
+    {
+      return components.add(entity_id);
+    }
+
+    component::name& get(om::id_type id)
+    {
+      return components.lookup(id);
+    }
+
+    void remove(om::id_type id)
+    {
+      components.remove(id);
+    }
+
+    bool has_for_entity(om::id_type entity_id)
+    {
+      return components.has_for_entity(entity_id);
+    }
+
+    component::name& get_for_entity(om::id_type entity_id)
+    {
+      return components.get_for_entity(entity_id);
+    }
+
+    om::component_store< component::name >& get_data()
+    {
+      return components;
+    }
+
+    //an entity with that name, om::index_mask if there is none, as of the last update
+    om::id_type find(const char* n)
+    {
+      symbol s = string_pool::get().find(n);
+      return s == string_pool::none ? om::index_mask : by_name.find(s);
+    }
+
+    om::name_index& get_index()
+    {
+      return by_name;
+    }
+
+    void declare_access(access& a)
+    {
+      //keeping the index current commits the store's change log
+      a.write< component::name >().write< std::ostream >();
+    }
+
+    const char* get_name()
+    {
+      return "name";
+    }
+
+    void save(om::snapshot_writer& w)
+    {
+      w.write_as< component::name_record >(snapshot_name, components.get_data(), [&w](const component::name& n)
+      {
+        component::name_record r = { n.id, w.add_string(n.c_str()) };
+        return r;
+      });
+    }
+
+    bool load(om::snapshot& s)
+    {
+      bool ok = s.load_as< component::name_record >(snapshot_name, components.get_data(), [&s](const component::name_record& r)
+      {
+        const char* str = s.get_string(r.str);
+        component::name n(str ? str : "");
+        n.id = r.id;
+        return n;
+      });
+
+      if( ok )
+      {
+        components.rebuild_index();
+        rebuild_by_name();
+      }
+      return ok;
+    }
+
+    void update()
+    {
+      renamed.each([this](om::id_type entity_id, const component::name& n)
+      {
+        by_name.add(entity_id, n.str);
+      },
+      [this](om::id_type entity_id)
+      {
+        by_name.remove(entity_id);
+      });
+
+      for( auto c = components.begin(); c != components.end(); ++c )
+      {
+        cout << c->second.c_str() << endl;
+      }
+    }
+  };
+
+  //parents and children, the children's positions follow their parent's
+  class transform : public base, public entity::removal_listener
+  {
+    om::hierarchy< component::pos > tree; //local offsets, and the world positions they add up to
+    pos& positions;
+  public:
+    transform(pos& p) : positions(p)
+    {
+      entity::manager::get().add_listener(this);
+    }
+
+    ~transform()
+    {
+      entity::manager::get().remove_listener(this);
+    }
+
+    //entities destroyed without destroy_subtree() leave the tree, their children stay where they are
+    void on_remove(om::id_type entity_id)
+    {
+      tree.unlink(entity_id);
+    }
+
+    //the entity moves with its parent from now on, offset is relative to the parent
+    void attach(om::id_type entity_id, om::id_type parent_id, const component::pos& offset = component::pos())
+    {
+      tree.add(entity_id, parent_id, offset);
+    }
+
+    //done on the next update, with every other reparent at once
+    void reparent(om::id_type entity_id, om::id_type parent_id)
+    {
+      tree.reparent(entity_id, parent_id);
+    }
+
+    //destroys the entity and everything under it on the next update
+    void destroy_subtree(om::id_type entity_id)
+    {
+      tree.remove_subtree(entity_id);
+    }
+
+    om::hierarchy< component::pos >& get_data()
+    {
+      return tree;
+    }
+
+    void declare_access(access& a)
+    {
+      a.write< component::pos >();
+    }
+
+    const char* get_name()
+    {
+      return "transform";
+    }
+
+    //changes queued since the last update aren't saved
+    void save(om::snapshot_writer& w)
+    {
+      w.write(snapshot_transform, tree.get_data());
+    }
+
+    bool load(om::snapshot& s)
+    {
+      if( !s.load(snapshot_transform, tree.get_data()) )
+        return false;
+
+      tree.rebuild_index();
+      return true;
+    }
+
+    void update()
+    {
+      tree.apply([this](om::id_type entity_id)
+      {
+        if( positions.has_for_entity(entity_id) )
+          commands::get().remove(positions.get_data(), positions.get_data().handle_for_entity(entity_id));
+        commands::get().destroy(entity_id);
+      });
+
+      tree.propagate([](const component::pos& parent, const component::pos& local)
+      {
+        return component::pos(parent.x + local.x, parent.y + local.y, parent.z + local.z);
+      });
+
+      //world positions go to the pos components, only the ones that moved count as changed
+      auto& nodes = tree.get_data().get_objects();
+      for( auto c = nodes.begin(); c != nodes.end(); ++c )
+      {
+        const component::pos& w = c->second.world;
+        if( !positions.has_for_entity(c->second.entity) )
+          continue;
+
+        om::id_type handle = positions.get_data().handle_for_entity(c->second.entity);
+        const component::pos& now = positions.get_data().get_data().read(handle);
+        if( now.x != w.x || now.y != w.y || now.z != w.z )
+        {
+          component::pos& p = positions.get(handle);
+          p.x = w.x;
+          p.y = w.y;
+          p.z = w.z;
+        }
+      }
+    }
+  };
+
+  //this is needed so that we can neatly just call tell this manager to update/init etc., 
+  //no need to know about the systems
+  class manager
+  {
+    list< base* > systems; 
+    vector< base* > order; //systems in the order the schedule was built for
+    scheduler schedule;
+  private:
+  protected:
+    manager(){} //singleton
+    manager(const manager&);
+    manager(manager&&);
+    manager& operator=(const manager&);
+  public:
+    void add( base* c )
+    {
+      systems.push_back(c);
+      order.clear(); //reschedule on the next update
+    }
+
+    //systems that don't conflict run in parallel, the others in the order they were added
+    void update()
+    {
+      CES_PROFILE_SCOPE("update");
+
+      entity::manager::get().singleton< component::frame >().number++;
+
+      if( order.empty() )
+      {
+        vector< access > accesses( systems.size() );
+        for( auto c = systems.begin(); c != systems.end(); ++c )
+        {
+          (*c)->declare_access( accesses[order.size()] );
+          order.push_back( *c );
+        }
+
+        schedule.build( accesses );
+      }
+
+      schedule.run( [this]( size_t i )
+      {
+        CES_PROFILE_SCOPE( order[i]->get_name() );
+        order[i]->update();
+      } );
+
+      //sync point, nothing iterates anymore
+      commands::get().flush( entity::manager::get() );
+    }
+
+    //writes the entities and every system's components to a file
+    bool save(const char* path)
+    {
+      om::snapshot_writer w;
+      if( !w.open(path) )
+        return false;
+
+      entity::manager::get().save(w);
+      for( auto c = systems.begin(); c != systems.end(); ++c )
+        (*c)->save(w);
+
+      return w.close();
+    }
+
+    //replaces the world with a saved one, handles saved before stay valid
+    bool load(const char* path)
+    {
+      om::snapshot s;
+      if( !s.open(path) || !entity::manager::get().load(s) )
+        return false;
+
+      bool ok = true;
+      for( auto c = systems.begin(); c != systems.end(); ++c )
+        ok = (*c)->load(s) && ok;
+
+      return ok;
+    }
+
+    void init()
+    {
+      for( auto c = systems.begin(); c != systems.end(); ++c )
+        (*c)->init();
+    }
+
+    void shutdown()
+    {
+      //destroy in reverse order
+      for( auto c = systems.rbegin(); c != systems.rend(); ++c )
+      {
+        (*c)->shutdown();
+        delete *c;
+      }
+    }
+
+    static manager& get()
+    {
+      static manager instance;
+      return instance;
+    }
+  };
+}
+}
+
+#ifdef CES_BENCHMARK
+//the benchmark's view of this type, see bench/bench.h
+namespace
+{
+  class engine : public bench::engine
+  {
+    //the stores the systems would hold, without the systems' change tracking
+    om::component_store< ces::component::pos > positions;
+    om::component_store< ces::component::name > names;
+    vector< om::id_type > handles;
+  public:
+    const char* name()
+    {
+      return "type_b";
+    }
+
+    void create(om::id_type* ids, size_t count)
+    {
+      ces::entity::manager::get().add_n(count, ids);
+
+      for( size_t c = 0; c < count; ++c )
+      {
+        positions.add(ids[c], ces::component::pos(float(c)));
+
+        if( c % 2 == 0 )
+          names.add(ids[c], ces::component::name("entity"));
+      }
+    }
+
+    //the entities and their components
+    void destroy(const om::id_type* ids, size_t count)
+    {
+      handles.clear();
+      for( size_t c = 0; c < count; ++c )
+        handles.push_back(positions.handle_for_entity(ids[c]));
+      positions.remove_n(handles.data(), handles.size());
+
+      handles.clear();
+      for( size_t c = 0; c < count; ++c )
+        if( names.has_for_entity(ids[c]) )
+          handles.push_back(names.handle_for_entity(ids[c]));
+      names.remove_n(handles.data(), handles.size());
+
+      ces::entity::manager::get().remove_n(ids, count);
+      vector< om::id_type >().swap(handles);
+    }
+
+    double iterate()
+    {
+      double sum = 0;
+      for( auto c = positions.begin(); c != positions.end(); ++c )
+        sum += c->second.x;
+      return sum;
+    }
+
+    double lookup(const om::id_type* ids, size_t count)
+    {
+      double sum = 0;
+      for( size_t c = 0; c < count; ++c )
+        sum += positions.get_data().read(positions.handle_for_entity(ids[c])).x;
+      return sum;
+    }
+
+    size_t join()
+    {
+      size_t count = 0;
+      om::make_view(positions, names).each([&](om::id_type, ces::component::pos&, ces::component::name& n)
+      {
+        count += n.str != ces::string_pool::empty;
+      });
+      return count;
+    }
+  };
+
+  bench::registrar registered(new engine);
+}
+#else
+//usage
+int main()
+{
+  auto pos_sys = new ces::system::pos; //systems will either need to be stored in a map, or kept around to access them
+  auto name_sys = new ces::system::name;
+  auto transform_sys = new ces::system::transform(*pos_sys);
+  ces::system::manager::get().add(pos_sys);
+  ces::system::manager::get().add(name_sys);
+  ces::system::manager::get().add(transform_sys);
+
+  //positions are mirrored elsewhere, the changes are kept until the mirror got them
+  uint32_t sent = 0;
+  pos_sys->get_data().add_reader(&sent);
+
+  om::id_type entity_with_pos = ces::entity::manager::get().add();
+  om::id_type pos_component1 = pos_sys->add(entity_with_pos);
+  auto& pc1 = pos_sys->get(pos_component1);
+  pc1.x = 1;
+  pc1.y = 2;
+  pc1.z = 3;
+
+  om::id_type entity_with_name = ces::entity::manager::get().add();
+  om::id_type name_component1 = name_sys->add(entity_with_name);
+  auto& nc1 = name_sys->get(name_component1);
+  nc1.str = ces::string_pool::get().intern("hello world");
+
+  om::id_type entity_with_pos_and_name = ces::entity::manager::get().add();
+  om::id_type pos_component2 = pos_sys->add(entity_with_pos_and_name);
+  auto& pc2 = pos_sys->get(pos_component2);
+  pc2.x = 4;
+  pc2.y = 5;
+  pc2.z = 6;
+  om::id_type name_component2 = name_sys->add(entity_with_pos_and_name);
+  auto& nc2 = name_sys->get(name_component2);
+  nc2.str = ces::string_pool::get().intern("world hello lolwut?");
+
+  //children follow their parent, their positions are set from the offsets every update
+  om::id_type child = ces::entity::manager::get().add();
+  pos_sys->add(child);
+  transform_sys->attach(entity_with_pos, om::index_mask, ces::component::pos(1, 2, 3));
+  transform_sys->attach(child, entity_with_pos, ces::component::pos(1, 0, 0));
+
+  //markers only cost a bit per entity
+  ces::entity::manager::get().tags< ces::component::selected >().add(entity_with_pos_and_name);
+
+  //components can also be found through the entity that owns them
+  if( pos_sys->has_for_entity(entity_with_pos_and_name) )
+  {
+    auto& pc3 = pos_sys->get_for_entity(entity_with_pos_and_name);
+    pc3.z = 7;
+  }
+
+  //spawning and despawning a whole wave reserves and patches the storage once
+  vector< om::id_type > wave(1000);
+  ces::entity::manager::get().add_n(wave.size(), wave.data());
+  ces::entity::manager::get().remove_n(wave.data(), wave.size() / 2);
+
+  //structural changes can also be recorded, they are applied at the end of the next update
+  for( size_t c = wave.size() / 2; c < wave.size(); ++c )
+    ces::commands::get().destroy(wave[c]);
+
+  //proximity queries go through a grid instead of scanning every position
+  pos_sys->index_space(10.0f);
+
+  ces::system::manager::get().init();
+  ces::system::manager::get().update();
+
+  vector< om::id_type > near;
+  const float center[3] = { 1, 2, 3 };
+  pos_sys->get_spatial_index()->query_radius(center, 6.0f, near);
+  pos_sys->get_spatial_index()->query_nearest(center, 1, near);
+  cout << near.size() - 1 << " entities within 6 of (1 2 3), the closest is " << near.back() << endl;
+
+  //names are interned, finding an entity by name is an array lookup
+  cout << "\"hello world\" is entity " << name_sys->find("hello world") << endl;
+
+  //an index can be reused before the dead entity's name is taken out, the new entity replaces it
+  om::object_manager< int > handles;
+  om::name_index names;
+  ces::symbol hello = ces::string_pool::get().intern("hello world");
+  names.add(handles.add(0), hello);
+  om::id_type dead = handles.add(0);
+  names.add(dead, hello);
+  handles.remove(dead);
+  om::id_type reborn = handles.add(0); //same index, next generation
+  names.add(reborn, hello);
+  size_t live = 0;
+  names.each(hello, [&](om::id_type entity_id){ live += entity_id != dead; });
+  cout << live << " entities named \"hello world\", the latest is " << ( names.find(hello) == reborn ? "the new one" : "the dead one" ) << endl;
+
+  auto& child_pos = pos_sys->get_for_entity(child);
+  cout << "child at " << child_pos.x << " " << child_pos.y << " " << child_pos.z << endl;
+
+  //after churn, names can be put back into the order of the positions, a little every frame
+  om::incremental_sort< ces::component::name > name_order(name_sys->get_data().get_data());
+  name_order.reorder_to_match(pos_sys->get_data());
+  while( !name_order.step(std::chrono::microseconds(100)) );
+
+  //entities that have both a position and a name, iterated from the smaller store
+  auto& selected = ces::entity::manager::get().tags< ces::component::selected >();
+  om::make_view(pos_sys->get_data(), name_sys->get_data()).each(
+    [&](om::id_type entity_id, ces::component::pos& p, ces::component::name& n)
+  {
+    cout << n.c_str() << ( selected.has(entity_id) ? " (selected)" : "" ) << ": " << p.x << " " << p.y << " " << p.z << endl;
+  });
+
+  //systems can also split their own work across all cores, summing without atomics
+  ces::per_thread< float > sums;
+  ces::parallel_each(pos_sys->get_data(), [&](std::pair< om::id_type, ces::component::pos >& c)
+  {
+    sums.local() += c.second.x;
+  });
+  cout << "sum of x: " << sums.combine(0.0f, [](float a, float b){ return a + b; }) << endl;
+
+  //only what changed since the last tick is sent to the mirror
+  om::object_manager< ces::component::pos > mirror;
+  om::delta_receiver< ces::component::pos > receiver;
+  vector< unsigned char > stream;
+  om::write_delta(pos_sys->get_data().get_data(), sent, stream);
+  sent = pos_sys->get_data().commit();
+  pos_sys->get_data().forget_read();
+  pos_sys->get_data().remove_reader(&sent);
+  receiver.apply(stream, mirror);
+  cout << "mirrored " << mirror.get_objects().size() << " positions in " << stream.size() << " bytes" << endl;
+
+  //the whole world can be saved, and loaded back in one copy per store
+  if( ces::system::manager::get().save("world.snapshot") && ces::system::manager::get().load("world.snapshot") )
+    cout << "reloaded " << pos_sys->get_data().size() << " positions" << endl;
+
+  cout << "frames: " << ces::entity::manager::get().singleton< ces::component::frame >().number << endl;
+
+  ces::system::manager::get().shutdown();
+
+	cin.get();
+	return 0;
+}
+#endif
+
 #endif
\ No newline at end of file
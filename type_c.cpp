@@ -0,0 +1,722 @@
+#include <iostream>
+#include <list>
+#include <vector>
+#include <map>
+#include <string>
+#include <new>
+#include <utility>
+#include <cassert>
+
+#include "object_manager.h"
+#include "ces_profiler.h"
+#include "ces_string_pool.h"
+
+#ifdef CES_BENCHMARK
+#include "bench/bench.h"
+#endif
+
+//#define USE_TYPE_C
+#ifdef USE_TYPE_C
+
+/*
+ * CES SYSTEM IMPLEMENTATION "C"
+ *
+ * In type C:
+ * Systems are separate, they only contain logic, no data. They are wrapped around by a system-manager.
+ * Entities are grouped by their exact set of components, each such set is an archetype.
+ * An archetype stores its entities in fixed size chunks, each chunk has one array per component type.
+ * Adding or removing a component moves the entity to another archetype, these moves are cached in a graph.
+ * Systems ask for the archetypes that have every component they need, and walk their chunks linearly,
+ * so there is no type check per entity, only per archetype.
+ *
+ * System Manager
+ *   -Systems
+ *
+ * Entity manager
+ *   -Entities
+ *     -ID
+ *     -archetype, chunk, row
+ *   -Archetypes
+ *     -component type set
+ *     -transitions (+/- component type -> archetype)
+ *     -Chunks (16 KB)
+ *       -entity IDs
+ *       -component arrays
+ */
+
+using namespace std;
+
+/*
+ * Components only contain data, no logic (only constructors/destructors maybe)
+ * They don't need a base class or an ID, the archetype knows who owns them.
+ */
+namespace ces
+{
+namespace component
+{
+  typedef unsigned long long signature; //one bit per component type, so at most 64 types
+
+  //everything the chunks need to know to store a component type
+  struct type_info
+  {
+    size_t size;
+    size_t align;
+    void (*move)( void* dst, void* src ); //move constructs dst from src
+    void (*destroy)( void* p );
+  };
+
+  class registry
+  {
+    vector< type_info > types;
+
+    template< class t >
+    static void move_thunk( void* dst, void* src )
+    {
+      new( dst ) t( std::move( *static_cast< t* >( src ) ) );
+    }
+
+    template< class t >
+    static void destroy_thunk( void* p )
+    {
+      static_cast< t* >( p )->~t();
+    }
+  protected:
+    registry(){} //singleton
+    registry(const registry&);
+    registry(registry&&);
+    registry& operator=(const registry&);
+  public:
+    template< class t >
+    unsigned add()
+    {
+      type_info ti;
+      ti.size = sizeof( t );
+      ti.align = alignof( t );
+      ti.move = &move_thunk< t >;
+      ti.destroy = &destroy_thunk< t >;
+      types.push_back( ti );
+      assert( types.size() <= 64 && "a signature holds at most 64 component types" );
+      return types.size() - 1;
+    }
+
+    const type_info& info( unsigned type )
+    {
+      return types[type];
+    }
+
+    static registry& get()
+    {
+      static registry instance;
+      return instance;
+    }
+  };
+
+  //type ids are handed out on first use
+  template< class t >
+  unsigned type_id()
+  {
+    static unsigned id = registry::get().add< t >();
+    return id;
+  }
+
+  template< class... t >
+  signature signature_of()
+  {
+    signature s = 0;
+    om::detail::expand( { ( s |= signature( 1 ) << type_id< t >(), 0 )... } );
+    return s;
+  }
+
+  class pos
+  {
+  public:
+    float x, y, z;
+    pos(float a = float(), float b = float(), float c = float()) : x(a), y(b), z(c) {}
+  };
+
+  class name
+  {
+  public:
+    symbol str; //interned, see string_pool
+    name(const char* n = "") : str(string_pool::get().intern(n)) {}
+
+    const char* c_str() const
+    {
+      return string_pool::get().str(str);
+    }
+  };
+}
+
+/*
+ * Entities. In this type they are only an ID and the place where their components are stored.
+ */
+namespace entity
+{
+  const size_t chunk_size = 16 * 1024;
+
+  struct chunk
+  {
+    unsigned char* data; //entity ids, then one array per component type
+    size_t count;
+  };
+
+  class archetype
+  {
+    archetype(const archetype&);
+    archetype& operator=(const archetype&);
+  public:
+    component::signature sig;
+    vector< unsigned > types; //component types stored here
+    vector< size_t > offsets; //offset of each type's array in a chunk, parallel to types
+    int columns[64]; //index into types for each component type, -1 if not stored here
+    size_t capacity; //entities per chunk
+    vector< chunk > chunks;
+    map< unsigned, archetype* > add_edges; //archetype with one more component type
+    map< unsigned, archetype* > remove_edges; //archetype with one less component type
+
+    om::id_type* ids( chunk& c )
+    {
+      return reinterpret_cast< om::id_type* >( c.data );
+    }
+
+    void* column( chunk& c, int col )
+    {
+      return c.data + offsets[col];
+    }
+
+    //address of one component of one entity
+    void* get( size_t ch, size_t row, unsigned type )
+    {
+      int col = columns[type];
+      return static_cast< unsigned char* >( column( chunks[ch], col ) ) + row * component::registry::get().info( type ).size;
+    }
+
+    //makes room for an entity, its components are left unconstructed
+    void push( om::id_type id, size_t& ch, size_t& row )
+    {
+      if( chunks.empty() || chunks.back().count == capacity )
+      {
+        chunk c;
+        c.data = new unsigned char[chunk_size];
+        c.count = 0;
+        chunks.push_back( c );
+      }
+
+      ch = chunks.size() - 1;
+      row = chunks.back().count++;
+      ids( chunks.back() )[row] = id;
+    }
+
+    //destroys an entity's components, and fills the hole with the last entity
+    //returns the id of the entity that was moved, or om::index_mask if none
+    om::id_type erase( size_t ch, size_t row )
+    {
+      for( size_t c = 0; c < types.size(); ++c )
+      {
+        component::registry::get().info( types[c] ).destroy( get( ch, row, types[c] ) );
+      }
+
+      size_t last_ch = chunks.size() - 1;
+      size_t last_row = chunks.back().count - 1;
+      om::id_type moved = om::index_mask;
+
+      if( last_ch != ch || last_row != row )
+      {
+        for( size_t c = 0; c < types.size(); ++c )
+        {
+          const component::type_info& ti = component::registry::get().info( types[c] );
+          ti.move( get( ch, row, types[c] ), get( last_ch, last_row, types[c] ) );
+          ti.destroy( get( last_ch, last_row, types[c] ) );
+        }
+
+        moved = ids( chunks[last_ch] )[last_row];
+        ids( chunks[ch] )[row] = moved;
+      }
+
+      if( --chunks.back().count == 0 )
+      {
+        delete [] chunks.back().data;
+        chunks.pop_back();
+      }
+
+      return moved;
+    }
+
+    archetype( component::signature s ) : sig( s )
+    {
+      size_t per_entity = sizeof( om::id_type );
+      for( unsigned c = 0; c < 64; ++c )
+      {
+        columns[c] = -1;
+        if( s & ( component::signature( 1 ) << c ) )
+        {
+          columns[c] = types.size();
+          types.push_back( c );
+          per_entity += component::registry::get().info( c ).size;
+        }
+      }
+
+      //lay out the arrays, shrink the chunk capacity until the alignment padding fits too
+      offsets.resize( types.size() );
+      for( capacity = chunk_size / per_entity; capacity > 0; --capacity )
+      {
+        size_t offset = capacity * sizeof( om::id_type );
+        for( size_t c = 0; c < types.size(); ++c )
+        {
+          const component::type_info& ti = component::registry::get().info( types[c] );
+          offset = ( offset + ti.align - 1 ) / ti.align * ti.align;
+          offsets[c] = offset;
+          offset += capacity * ti.size;
+        }
+
+        if( offset <= chunk_size )
+        {
+          break;
+        }
+      }
+
+      assert( capacity > 0 && "the components of an archetype don't fit in a chunk" );
+    }
+
+    ~archetype()
+    {
+      while( !chunks.empty() )
+      {
+        erase( chunks.size() - 1, chunks.back().count - 1 );
+      }
+    }
+  };
+
+  //where an entity's components live
+  struct record
+  {
+    archetype* arch;
+    size_t chunk;
+    size_t row;
+  };
+
+  class manager
+  {
+    om::object_manager< record > entities; //collection of entities
+    map< component::signature, archetype* > archetypes;
+
+    archetype* find( component::signature s )
+    {
+      auto it = archetypes.find( s );
+      if( it != archetypes.end() )
+      {
+        return it->second;
+      }
+
+      archetype* a = new archetype( s );
+      archetypes[s] = a;
+      return a;
+    }
+
+    archetype* with( archetype* a, unsigned type )
+    {
+      if( a->columns[type] >= 0 ) //has it already, there is no edge to itself
+      {
+        return a;
+      }
+
+      auto it = a->add_edges.find( type );
+      if( it != a->add_edges.end() )
+      {
+        return it->second;
+      }
+
+      archetype* to = find( a->sig | ( component::signature( 1 ) << type ) );
+      a->add_edges[type] = to;
+      to->remove_edges[type] = a;
+      return to;
+    }
+
+    archetype* without( archetype* a, unsigned type )
+    {
+      if( a->columns[type] < 0 ) //doesn't have it, there is no edge to itself
+      {
+        return a;
+      }
+
+      auto it = a->remove_edges.find( type );
+      if( it != a->remove_edges.end() )
+      {
+        return it->second;
+      }
+
+      archetype* to = find( a->sig & ~( component::signature( 1 ) << type ) );
+      a->remove_edges[type] = to;
+      to->add_edges[type] = a;
+      return to;
+    }
+
+    //moves the components the two archetypes share, the rest is destroyed
+    //components only in the new archetype have to be constructed by the caller
+    void move( om::id_type id, archetype* to )
+    {
+      record& r = entities.lookup( id );
+      archetype* from = r.arch;
+      if( to == from )
+      {
+        return;
+      }
+
+      size_t ch, row;
+      to->push( id, ch, row );
+
+      for( size_t c = 0; c < to->types.size(); ++c )
+      {
+        unsigned type = to->types[c];
+        if( from->columns[type] >= 0 )
+        {
+          component::registry::get().info( type ).move( to->get( ch, row, type ), from->get( r.chunk, r.row, type ) );
+        }
+      }
+
+      om::id_type moved = from->erase( r.chunk, r.row );
+      if( moved != om::index_mask )
+      {
+        record& m = entities.lookup( moved );
+        m.chunk = r.chunk;
+        m.row = r.row;
+      }
+
+      r.arch = to;
+      r.chunk = ch;
+      r.row = row;
+    }
+
+    template< class f, class... t >
+    static void each_chunk( f& func, om::id_type* ids, size_t count, t*... arrays )
+    {
+      for( size_t c = 0; c < count; ++c )
+      {
+        func( ids[c], arrays[c]... );
+      }
+    }
+  private:
+  protected:
+    manager(){} //singleton
+    manager(const manager&);
+    manager(manager&&);
+    manager& operator=(const manager&);
+  public:
+    om::id_type add()
+    {
+      record r;
+      r.arch = find( 0 );
+      om::id_type id = entities.add( r );
+      record& rr = entities.lookup( id );
+      rr.arch->push( id, rr.chunk, rr.row );
+      return id;
+    }
+
+    void remove( om::id_type id )
+    {
+      record& r = entities.lookup( id );
+      om::id_type moved = r.arch->erase( r.chunk, r.row );
+      if( moved != om::index_mask )
+      {
+        record& m = entities.lookup( moved );
+        m.chunk = r.chunk;
+        m.row = r.row;
+      }
+
+      entities.remove( id );
+    }
+
+    //the returned reference is valid until the next structural change
+    template< class t >
+    t& add_component( om::id_type id, const t& d = t() )
+    {
+      unsigned type = component::type_id< t >();
+      if( entities.lookup( id ).arch->columns[type] >= 0 ) //already has one, nothing moves
+      {
+        return get_component< t >( id ) = d;
+      }
+
+      move( id, with( entities.lookup( id ).arch, type ) );
+      record& r = entities.lookup( id );
+      return *new( r.arch->get( r.chunk, r.row, type ) ) t( d );
+    }
+
+    template< class t >
+    void remove_component( om::id_type id )
+    {
+      if( !has_component< t >( id ) )
+      {
+        return;
+      }
+
+      move( id, without( entities.lookup( id ).arch, component::type_id< t >() ) );
+    }
+
+    template< class t >
+    bool has_component( om::id_type id )
+    {
+      return entities.lookup( id ).arch->columns[component::type_id< t >()] >= 0;
+    }
+
+    //the returned reference is valid until the next structural change
+    template< class t >
+    t& get_component( om::id_type id )
+    {
+      record& r = entities.lookup( id );
+      return *static_cast< t* >( r.arch->get( r.chunk, r.row, component::type_id< t >() ) );
+    }
+
+    //calls func( id, t&... ) for every entity that has all of the given components
+    template< class... t, class f >
+    void each( f func )
+    {
+      component::signature mask = component::signature_of< t... >();
+      for( auto c = archetypes.begin(); c != archetypes.end(); ++c )
+      {
+        archetype* a = c->second;
+        if( ( a->sig & mask ) != mask )
+        {
+          continue;
+        }
+
+        for( auto d = a->chunks.begin(); d != a->chunks.end(); ++d )
+        {
+          each_chunk( func, a->ids( *d ), d->count,
+                      static_cast< t* >( a->column( *d, a->columns[component::type_id< t >()] ) )... );
+        }
+      }
+    }
+
+    void shutdown()
+    {
+      for( auto c = archetypes.begin(); c != archetypes.end(); ++c )
+      {
+        delete c->second;
+      }
+
+      archetypes.clear();
+    }
+
+    static manager& get()
+    {
+      static manager instance;
+      return instance;
+    }
+  };
+}
+
+/*
+ * Systems should contain all the logic to make components work
+ * In this type of CES, systems don't hold the data (components), the archetypes do.
+ */
+namespace system
+{
+  class base
+  {
+  public:
+    virtual void init(){}
+    virtual void shutdown(){}
+    virtual void update(){}
+    virtual const char* get_name(){ return "system"; } //shows up in the profiler
+    virtual ~base(){}
+  };
+
+  class pos : public base
+  {
+  public:
+    const char* get_name()
+    {
+      return "pos";
+    }
+
+    void update()
+    {
+      entity::manager::get().each< component::pos >( []( om::id_type, component::pos& p )
+      {
+        cout << p.x << " " << p.y << " " << p.z << endl; //perform something on them
+      } );
+    }
+  };
+
+  class name : public base
+  {
+  public:
+    const char* get_name()
+    {
+      return "name";
+    }
+
+    void update()
+    {
+      entity::manager::get().each< component::name >( []( om::id_type, component::name& n )
+      {
+        cout << n.c_str() << endl;
+      } );
+    }
+  };
+
+  //this is needed so that we can neatly just call tell this manager to update/init etc.,
+  //no need to know about the systems
+  class manager
+  {
+    list< base* > systems;
+  private:
+  protected:
+    manager(){} //singleton
+    manager(const manager&);
+    manager(manager&&);
+    manager& operator=(const manager&);
+  public:
+    void add( base* c )
+    {
+      systems.push_back(c);
+    }
+
+    void update()
+    {
+      CES_PROFILE_SCOPE("update");
+
+      for( auto c = systems.begin(); c != systems.end(); ++c )
+      {
+        CES_PROFILE_SCOPE( (*c)->get_name() );
+        (*c)->update();
+      }
+    }
+
+    void init()
+    {
+      for( auto c = systems.begin(); c != systems.end(); ++c )
+        (*c)->init();
+    }
+
+    void shutdown()
+    {
+      //destroy in reverse order
+      for( auto c = systems.rbegin(); c != systems.rend(); ++c )
+      {
+        (*c)->shutdown();
+        delete *c;
+      }
+    }
+
+    static manager& get()
+    {
+      static manager instance;
+      return instance;
+    }
+  };
+}
+}
+
+#ifdef CES_BENCHMARK
+//the benchmark's view of this type, see bench/bench.h
+namespace
+{
+  class engine : public bench::engine
+  {
+  public:
+    const char* name()
+    {
+      return "type_c";
+    }
+
+    void create( om::id_type* ids, size_t count )
+    {
+      auto& em = ces::entity::manager::get();
+
+      for( size_t c = 0; c < count; ++c )
+      {
+        ids[c] = em.add();
+        em.add_component( ids[c], ces::component::pos( float( c ) ) );
+
+        if( c % 2 == 0 )
+          em.add_component( ids[c], ces::component::name( "entity" ) );
+      }
+    }
+
+    void destroy( const om::id_type* ids, size_t count )
+    {
+      auto& em = ces::entity::manager::get();
+
+      for( size_t c = 0; c < count; ++c )
+        em.remove( ids[c] );
+
+      em.shutdown(); //the archetypes are empty by now
+    }
+
+    double iterate()
+    {
+      double sum = 0;
+      ces::entity::manager::get().each< ces::component::pos >( [&]( om::id_type, ces::component::pos& p )
+      {
+        sum += p.x;
+      } );
+      return sum;
+    }
+
+    double lookup( const om::id_type* ids, size_t count )
+    {
+      double sum = 0;
+      for( size_t c = 0; c < count; ++c )
+        sum += ces::entity::manager::get().get_component< ces::component::pos >( ids[c] ).x;
+      return sum;
+    }
+
+    size_t join()
+    {
+      size_t count = 0;
+      ces::entity::manager::get().each< ces::component::pos, ces::component::name >(
+        [&]( om::id_type, ces::component::pos&, ces::component::name& n )
+      {
+        count += n.str != ces::string_pool::empty;
+      } );
+      return count;
+    }
+  };
+
+  bench::registrar registered( new engine );
+}
+#else
+//usage
+int main()
+{
+  ces::system::manager::get().add(new ces::system::pos);
+  ces::system::manager::get().add(new ces::system::name);
+
+  auto& em = ces::entity::manager::get();
+
+  om::id_type entity_with_pos = em.add();
+  em.add_component(entity_with_pos, ces::component::pos(1, 2, 3));
+
+  om::id_type entity_with_name = em.add();
+  em.add_component(entity_with_name, ces::component::name("hello world"));
+
+  om::id_type entity_with_pos_and_name = em.add();
+  em.add_component(entity_with_pos_and_name, ces::component::pos(4, 5, 6));
+  em.add_component(entity_with_pos_and_name, ces::component::name("world hello lolwut?"));
+
+  //removing a component the entity doesn't have changes nothing, adding it back works as usual
+  em.remove_component< ces::component::name >(entity_with_pos);
+  em.add_component(entity_with_pos, ces::component::name("positioned"));
+  em.remove_component< ces::component::name >(entity_with_pos);
+
+  ces::system::manager::get().init();
+  ces::system::manager::get().update();
+
+  //only visits the archetypes that have both components
+  em.each< ces::component::pos, ces::component::name >(
+    []( om::id_type, ces::component::pos& p, ces::component::name& n )
+  {
+    cout << n.c_str() << ": " << p.x << " " << p.y << " " << p.z << endl;
+  } );
+
+  ces::system::manager::get().shutdown();
+
+  ces::entity::manager::get().shutdown();
+
+	cin.get();
+	return 0;
+}
+#endif
+
+#endif